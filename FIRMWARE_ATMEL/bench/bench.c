@@ -0,0 +1,299 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'bench.c'
+// Title		: Cycle benchmark of the FMC FRU Programmer firmware in simavr
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host with simavr and avr-gcc
+// ************************************************************************
+// Runs the firmware ELF (linked with bench_usb.c) on a simulated ATMEGA32U4 at 8 MHz with two
+// EEPROMs on the TWI bus, a 24C02 at 0x50 and a 24C32 at 0x51. Every instruction is executed
+// one by one, its cycles are counted for the command in progress (GPIOR0 of bench_usb.c) and
+// for the function it belongs to:
+//    usb_serial  functions usb_*
+//    i2c         functions i2c_* and the TWI interrupt
+//    other       everything else, e.g. main loop, timer and LED handling
+// Function addresses are taken from avr-nm. Cycles are counted where they are spent, a call
+// from main to i2c_write counts the cycles of i2c_write for i2c and the call itself for other.
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_irq.h>
+#include <simavr/avr_twi.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BENCH_F_CPU        8000000     // CPU clock of the FMC FRU Programmer
+#define BENCH_CYCLES_MAX   2000000000ULL // give up after 250 s of simulated time
+#define BENCH_SYMBOLS_MAX  1024
+#define BENCH_TWR_US       5000        // internal write cycle of the EEPROMs
+
+#define GPIOR0_ADDR        0x3E        // data space addresses of ATMEGA32U4
+#define GPIOR1_ADDR        0x4A
+#define GPIOR2_ADDR        0x4B
+#define TWI_VECTOR         36          // TWI_vect of ATMEGA32U4
+
+enum { PART_OTHER, PART_USB, PART_I2C, PART_N };
+static const char* part_names[PART_N] = { "other", "usb_serial", "i2c" };
+
+typedef struct
+{
+   uint32_t addr;                      // byte address in flash
+   uint8_t  part;                      // PART_*
+} bench_symbol;
+
+typedef struct
+{
+   uint32_t count;                     // commands executed
+   uint64_t cycles[PART_N];            // cycles per part
+   uint32_t tx_bytes;                  // bytes sent to the host
+} bench_command;
+
+typedef struct
+{
+   avr_t*      avr;
+   avr_irq_t*  irq;                    // TWI_IRQ_INPUT and TWI_IRQ_OUTPUT of the device
+   uint8_t     address;                // 7 bit I2C address
+   uint32_t    size;                   // array size in bytes
+   uint8_t     page;                   // page size in bytes
+   uint8_t     addr_bytes;             // word address bytes
+   uint8_t     selected;               // address byte of current transaction, 0: not selected
+   uint8_t     addr_count;             // word address bytes received
+   uint32_t    addr;                   // word address counter
+   uint8_t     written;                // data bytes received in current transaction
+   uint8_t     busy;                   // internal write cycle in progress
+   uint8_t     data[4096];             // memory array
+} bench_eeprom;
+
+static bench_symbol  symbols[BENCH_SYMBOLS_MAX];
+static int           N_symbols;
+static bench_command commands[256];    // indexed by command byte
+static int           command = -1;     // command in progress, -1: before first command
+static int           finished;         // script of bench_usb.c is finished
+
+static const char* irq_names[2] = { [TWI_IRQ_INPUT] = "8>eeprom.out", [TWI_IRQ_OUTPUT] = "32<eeprom.in" };
+
+/*
+ * Read function addresses with avr-nm, sorted by address
+ */
+static int load_symbols(const char* elf)
+{
+   char     line[256];
+   char     name[200];
+   char     type;
+   unsigned addr;
+   FILE*    fp;
+
+   snprintf(line, sizeof(line), "avr-nm -n %s", elf);
+   fp = popen(line, "r");
+   if (fp == NULL)
+      return 0;
+   while (fgets(line, sizeof(line), fp) && (N_symbols < BENCH_SYMBOLS_MAX))
+   {
+      if ((sscanf(line, "%x %c %199s", &addr, &type, name) != 3) || ((type != 'T') && (type != 't')))
+         continue;                                                       // only code
+      symbols[N_symbols].addr = addr;
+      if (strncmp(name, "usb_", 4) == 0)
+         symbols[N_symbols].part = PART_USB;
+      else if ((strncmp(name, "i2c_", 4) == 0) || ((strncmp(name, "__vector_", 9) == 0) && (atoi(name + 9) == TWI_VECTOR)))
+         symbols[N_symbols].part = PART_I2C;
+      else
+         symbols[N_symbols].part = PART_OTHER;
+      N_symbols++;
+   }
+   pclose(fp);
+   return N_symbols;
+}
+
+/*
+ * Part of the function that contains pc
+ */
+static uint8_t lookup_part(uint32_t pc)
+{
+   static int last;                                                      // most lookups hit the same function again
+   int        lo = 0;
+   int        hi = N_symbols - 1;
+
+   if ((last + 1 < N_symbols) && (symbols[last].addr <= pc) && (pc < symbols[last + 1].addr))
+      return symbols[last].part;
+   while (lo < hi)
+   {
+      int mid = (lo + hi + 1) / 2;
+      if (symbols[mid].addr <= pc)
+         lo = mid;
+      else
+         hi = mid - 1;
+   }
+   last = lo;
+   return symbols[lo].part;
+}
+
+static void gpior_write(avr_t* avr, avr_io_addr_t addr, uint8_t v, void* param)
+{
+   (void)param;
+   avr->data[addr] = v;
+   if (addr == GPIOR0_ADDR)
+   {
+      command = v;
+      commands[command].count++;
+   }
+   else if ((addr == GPIOR1_ADDR) && (command >= 0))
+      commands[command].tx_bytes++;
+   else if ((addr == GPIOR2_ADDR) && v)
+      finished = 1;
+}
+
+/*
+ * End of the internal write cycle
+ */
+static avr_cycle_count_t eeprom_twr_done(avr_t* avr, avr_cycle_count_t when, void* param)
+{
+   (void)avr; (void)when;
+   ((bench_eeprom*)param)->busy = 0;
+   return 0;
+}
+
+/*
+ * 24Cxx EEPROM on the TWI bus, same behavior as FIRMWARE_ATMEL/sim/sim_eeprom.c without block select
+ */
+static void eeprom_hook(struct avr_irq_t* irq, uint32_t value, void* param)
+{
+   bench_eeprom*     ee = (bench_eeprom*)param;
+   avr_twi_msg_irq_t v;
+
+   (void)irq;
+   v.u.v = value;
+   if (v.u.twi.msg & TWI_COND_STOP)
+   {
+      if (ee->selected && !(ee->selected & 1) && ee->written)          // stop starts the internal write cycle
+      {
+         ee->busy = 1;
+         avr_cycle_timer_register_usec(ee->avr, BENCH_TWR_US, eeprom_twr_done, ee);
+      }
+      ee->selected = 0;
+   }
+   if (v.u.twi.msg & TWI_COND_START)
+   {
+      ee->selected = 0;
+      if (((v.u.twi.addr >> 1) == ee->address) && !ee->busy)             // no ACK during write cycle
+      {
+         ee->selected   = v.u.twi.addr;
+         ee->addr_count = 0;
+         ee->written    = 0;
+         avr_raise_irq(ee->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, ee->selected, 1));
+      }
+   }
+   if (!ee->selected)
+      return;
+   if (v.u.twi.msg & TWI_COND_WRITE)
+   {
+      avr_raise_irq(ee->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, ee->selected, 1));
+      if (ee->addr_count < ee->addr_bytes)
+      {
+         ee->addr = ((ee->addr << 8) | v.u.twi.data) & (ee->size - 1);  // address bytes are shifted into the counter
+         ee->addr_count++;
+      }
+      else
+      {
+         ee->data[ee->addr] = v.u.twi.data;
+         ee->addr = (ee->addr & ~(uint32_t)(ee->page - 1)) | ((ee->addr + 1) & (ee->page - 1)); // roll over within the page
+         ee->written++;
+      }
+   }
+   if (v.u.twi.msg & TWI_COND_READ)
+   {
+      avr_raise_irq(ee->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_READ, ee->selected, ee->data[ee->addr]));
+      ee->addr = (ee->addr + 1) & (ee->size - 1);                       // sequential read wraps at end of array
+   }
+}
+
+static void eeprom_init(avr_t* avr, bench_eeprom* ee, uint8_t address, uint32_t size, uint8_t page, uint8_t addr_bytes)
+{
+   memset(ee, 0, sizeof(bench_eeprom));
+   memset(ee->data, 0xFF, sizeof(ee->data));                           // erased state
+   ee->avr        = avr;
+   ee->address    = address;
+   ee->size       = size;
+   ee->page       = page;
+   ee->addr_bytes = addr_bytes;
+   ee->irq        = avr_alloc_irq(&avr->irq_pool, 0, 2, irq_names);
+   avr_irq_register_notify(ee->irq + TWI_IRQ_OUTPUT, eeprom_hook, ee);
+   avr_connect_irq(ee->irq + TWI_IRQ_INPUT, avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+   avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), ee->irq + TWI_IRQ_OUTPUT);
+}
+
+int main(int argc, char* argv[])
+{
+   elf_firmware_t    firmware;
+   avr_t*            avr;
+   bench_eeprom      eeproms[2];
+   avr_cycle_count_t cycle;
+   uint32_t          pc;
+   int               state = cpu_Running;
+
+   if (argc != 2)
+   {
+      fprintf(stderr, "usage: %s FMC_FRU_PROGRAMMER_BENCH.elf\n", argv[0]);
+      return 1;
+   }
+   memset(&firmware, 0, sizeof(firmware));
+   if (elf_read_firmware(argv[1], &firmware))
+   {
+      fprintf(stderr, "%s: cannot read firmware\n", argv[1]);
+      return 1;
+   }
+   if (!load_symbols(argv[1]))
+   {
+      fprintf(stderr, "%s: no symbols, avr-nm is needed\n", argv[1]);
+      return 1;
+   }
+   avr = avr_make_mcu_by_name("atmega32u4");
+   if (avr == NULL)
+      return 1;
+   avr_init(avr);
+   firmware.frequency = BENCH_F_CPU;
+   avr_load_firmware(avr, &firmware);
+
+   eeprom_init(avr, &eeproms[0], 0x50, 256, 8, 1);                      // 24C02
+   eeprom_init(avr, &eeproms[1], 0x51, 4096, 32, 2);                    // 24C32
+   avr_register_io_write(avr, GPIOR0_ADDR, gpior_write, NULL);
+   avr_register_io_write(avr, GPIOR1_ADDR, gpior_write, NULL);
+   avr_register_io_write(avr, GPIOR2_ADDR, gpior_write, NULL);
+
+   while (!finished && (state != cpu_Done) && (state != cpu_Crashed) && (avr->cycle < BENCH_CYCLES_MAX))
+   {
+      pc    = avr->pc;
+      cycle = avr->cycle;
+      state = avr_run(avr);
+      if (command >= 0)
+         commands[command].cycles[lookup_part(pc)] += avr->cycle - cycle;
+   }
+   if (!finished)
+   {
+      fprintf(stderr, "firmware stopped before the end of the script (state %d, %llu cycles)\n",
+              state, (unsigned long long)avr->cycle);
+      return 1;
+   }
+
+   printf("command  count   cycles/cmd    us/cmd   %10s %10s %10s   bytes/cmd\n", part_names[PART_USB], part_names[PART_I2C], part_names[PART_OTHER]);
+   for (int c = 0; c < 256; c++)
+   {
+      bench_command* b = &commands[c];
+      uint64_t       total;
+
+      if (b->count == 0)
+         continue;
+      total = b->cycles[PART_USB] + b->cycles[PART_I2C] + b->cycles[PART_OTHER];
+      printf("   %c    %6u %12llu %9.1f   %10llu %10llu %10llu   %9.1f\n", c, b->count,
+             (unsigned long long)(total / b->count), (double)total / b->count * 1e6 / BENCH_F_CPU,
+             (unsigned long long)(b->cycles[PART_USB] / b->count), (unsigned long long)(b->cycles[PART_I2C] / b->count),
+             (unsigned long long)(b->cycles[PART_OTHER] / b->count), (double)b->tx_bytes / b->count);
+   }
+   return 0;
+}
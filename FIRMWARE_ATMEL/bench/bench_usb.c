@@ -0,0 +1,130 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'bench_usb.c'
+// Title		: Scripted USB CDC endpoint for the cycle benchmark
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: ATMEGA32U4 in simavr, replaces usb_serial.c
+// ************************************************************************
+// The firmware is linked with this file instead of usb_serial.c and runs in simavr (bench.c).
+// Commands come from a script in flash, one packet per command, every packet is repeated.
+// The general purpose I/O registers tell the benchmark what happens:
+//    GPIOR0  first byte of a packet, written when the packet is received (start of a command)
+//    GPIOR1  every byte sent to the host, like a write to UEDATX
+//    GPIOR2  1 when the script is finished
+
+#include "../includes/usb_serial.h"
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#define BENCH_REPEAT  16               // every packet of the script is received this often
+
+// script entries: repeat, length, packet, a repeat of 0 ends the script
+// I2C address 0x50 is a 24C02 (1 byte addressing), 0x51 a 24C32 (2 byte addressing), see bench.c
+static const uint8_t script[] PROGMEM =
+{
+   1,            2, 'b', 8,                                          // read burst 8 bytes
+   BENCH_REPEAT, 3, 'r', 0x50, 0x00,
+   BENCH_REPEAT, 4, 'R', 0x51, 0x00, 0x00,
+   BENCH_REPEAT, 11, 'w', 0x50, 0x10, 1, 2, 3, 4, 5, 6, 7, 8,         // one page of 8 bytes
+   BENCH_REPEAT, 36, 'W', 0x51, 0x00, 0x20, 1, 2, 3, 4, 5, 6, 7, 8,   // one page of 32 bytes
+                     9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20,
+                     21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32,
+   4,            1, 's',
+   0
+};
+
+static const uint8_t* entry = script;  // current script entry
+static uint8_t        repeat;          // receptions of current packet left
+static uint8_t        rx_len;          // bytes in current packet
+static uint8_t        rx_pos;          // bytes taken from current packet
+
+// receive next packet if the current one is used up
+static uint8_t rx_packet(void)
+{
+   if (rx_pos < rx_len)
+      return 1;
+   if (repeat == 0)
+   {
+      if (rx_len)
+         entry = entry + 2 + rx_len;                                     // next script entry
+      rx_len = 0;
+      repeat = pgm_read_byte(entry);
+      if (repeat == 0)
+      {
+         GPIOR2 = 1;                                                     // end of script
+         return 0;
+      }
+   }
+   repeat = repeat - 1;
+   rx_len = pgm_read_byte(entry + 1);
+   rx_pos = 0;
+   GPIOR0 = pgm_read_byte(entry + 2);                                    // start of command
+   return 1;
+}
+
+void usb_init(void)
+{
+}
+
+uint8_t usb_configured(void)
+{
+   return 1;
+}
+
+int16_t usb_serial_getchar(void)
+{
+   if (!rx_packet())
+      return -1;
+   return pgm_read_byte(entry + 2 + rx_pos++);
+}
+
+uint8_t usb_serial_available(void)
+{
+   rx_packet();
+   return rx_len - rx_pos;
+}
+
+void usb_serial_flush_input(void)
+{
+}
+
+void usb_serial_flush_packet(void)
+{
+   rx_pos = rx_len;
+}
+
+int8_t usb_serial_putchar(uint8_t c)
+{
+   GPIOR1 = c;
+   return 0;
+}
+
+int8_t usb_serial_putchar_nowait(uint8_t c)
+{
+   GPIOR1 = c;
+   return 0;
+}
+
+int8_t usb_serial_write(const uint8_t *buffer, uint16_t size)
+{
+   while (size--)
+      GPIOR1 = *buffer++;
+   return 0;
+}
+
+void usb_serial_flush_output(void)
+{
+}
+
+uint32_t usb_serial_get_baud(void)      { return 115200; }
+uint8_t  usb_serial_get_stopbits(void)  { return USB_SERIAL_1_STOP; }
+uint8_t  usb_serial_get_paritytype(void){ return USB_SERIAL_PARITY_NONE; }
+uint8_t  usb_serial_get_numbits(void)   { return 8; }
+uint8_t  usb_serial_get_control(void)   { return USB_SERIAL_DTR | USB_SERIAL_RTS; }
+int8_t   usb_serial_set_control(uint8_t signals) { (void)signals; return 0; }
@@ -13,6 +13,24 @@
 // ************************************************************************
 
 #include "./includes/fru_programmer.h"
+#include "./includes/usb_serial.h"
+
+/*
+ * Profiling counters of a phase over all commands, in timer ticks
+ */
+typedef struct
+{
+   uint32_t count;                     // commands with this phase
+   uint32_t min;                       // shortest phase of a command
+   uint32_t max;                       // longest phase of a command
+   uint32_t total;                     // sum over all commands
+} prof_counter;
+
+static prof_counter prof[PROF_PHASES];
+static uint32_t     prof_commands;     // commands counted since last reset
+static uint32_t     prof_cmd[PROF_PHASES];  // phases of current command
+static uint8_t      prof_seen;         // bit mask of phases of current command
+static uint16_t     prof_last;         // timer value at end of last phase
 
 /*
  * initializes all data direction registers
@@ -47,6 +65,15 @@ void init_IOports(void)
    PORTD &= ~(1 << PD2);  // Tri-State, has external Pull-Up
 }
 
+/*
+ * starts timer 1 as free running time base (F_CPU / 64, 8 us per tick)
+ */
+void init_timer(void)
+{
+   TCCR1A = 0x00;                         // normal mode, no output compare
+   TCCR1B = (1 << CS11) | (1 << CS10);    // prescaler 64
+}
+
 /*
  * Changes state of LED
  */
@@ -129,4 +156,91 @@ uint8_t get_GA_state(void)
    ret |= (GA1 << 1);
    ret |= (GA0 << 0);
    return ret;
-}
\ No newline at end of file
+}
+/*
+ * Begin of a command, the first byte was received from the host
+ */
+void prof_start(void)
+{
+   for (uint8_t i=0; i<PROF_PHASES; i++)
+      prof_cmd[i] = 0;
+   prof_seen = 0;
+   prof_last = TCNT1;
+}
+
+/*
+ * End of a phase, the time since the last mark is added to the phase
+ * a phase may occur several times in a command, e.g. per chunk of a streaming write
+ */
+void prof_mark(uint8_t phase)
+{
+   uint16_t now = TCNT1;
+
+   prof_cmd[phase] = prof_cmd[phase] + (uint16_t)(now - prof_last);
+   prof_seen      |= (1 << phase);
+   prof_last       = now;
+}
+
+/*
+ * End of a command after the reply was sent, the time since the last mark is USB transmit
+ * the phases of the command are added to the counters
+ */
+void prof_end(void)
+{
+   prof_mark(PROF_USB_TX);
+   for (uint8_t i=0; i<PROF_PHASES; i++)
+   {
+      if (!(prof_seen & (1 << i)))
+         continue;                                                   // phase did not occur in this command
+      if ((prof[i].count == 0) || (prof_cmd[i] < prof[i].min))
+         prof[i].min = prof_cmd[i];
+      if (prof_cmd[i] > prof[i].max)
+         prof[i].max = prof_cmd[i];
+      prof[i].total = prof[i].total + prof_cmd[i];
+      prof[i].count = prof[i].count + 1;
+   }
+   prof_commands = prof_commands + 1;
+}
+
+static void prof_put32(uint32_t value)
+{
+   usb_serial_putchar(value >> 24);
+   usb_serial_putchar(value >> 16);
+   usb_serial_putchar(value >> 8);
+   usb_serial_putchar(value & 0xFF);
+}
+
+/*
+ * Send the profiling counters to the host, all values are 32 bit MSB first
+ *   ACK, tick length in us, number of phases, number of commands,
+ *   count, min, max and total in timer ticks of every phase
+ */
+void prof_dump(void)
+{
+   usb_serial_putchar(UART_ACK);
+   usb_serial_putchar(TIMER_TICK_US);
+   usb_serial_putchar(PROF_PHASES);
+   prof_put32(prof_commands);
+   for (uint8_t i=0; i<PROF_PHASES; i++)
+   {
+      prof_put32(prof[i].count);
+      prof_put32(prof[i].min);
+      prof_put32(prof[i].max);
+      prof_put32(prof[i].total);
+   }
+}
+
+/*
+ * Clear all profiling counters
+ */
+void prof_reset(void)
+{
+   for (uint8_t i=0; i<PROF_PHASES; i++)
+   {
+      prof[i].count = 0;
+      prof[i].min   = 0;
+      prof[i].max   = 0;
+      prof[i].total = 0;
+   }
+   prof_commands = 0;
+}
@@ -14,6 +14,13 @@
 
 #include "./includes/i2c.h"
 
+#include <avr/interrupt.h>
+
+static i2c_xfer* volatile i2c_queue[I2C_QUEUE_SIZE];  // queued transfers, first one is in progress
+static volatile uint8_t   i2c_head;                   // index of transfer in progress
+static volatile uint8_t   i2c_count;                  // number of queued transfers
+static volatile uint8_t   i2c_index;                  // index of next byte of transfer in progress
+
 void i2c_init()
 {
 	TWCR = 0;
@@ -23,6 +30,12 @@ void i2c_init()
 	TWBR = 32;			// 100kHz = SCL clockspeed = f_cpu / (16 + 2*TWBR*1)	 
 }
 
+void i2c_setClock(uint8_t twbr, uint8_t twps)
+{
+	TWBR = twbr;                // SCL clockspeed = f_cpu / (16 + 2*TWBR*4^TWPS)
+	TWSR = twps & 0x03;         // Prescaler 1, 4, 16, 64
+}
+
 void i2c_writeByte(uint8_t data)
 {
 	TWDR = data;
@@ -39,6 +52,7 @@ void i2c_startCondition()
 void i2c_stopCondition()
 {
 	TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+	while (TWCR & (1 << TWSTO));     // Stop Condition sent, bus is free for next start
 }
 
 void i2c_write(uint8_t address, uint8_t* buffer, uint8_t length)
@@ -90,6 +104,219 @@ uint8_t i2c_read(uint8_t address, uint8_t* buffer, uint8_t length)
 	return 1;
 }
 
+// start a sequential read of any length, returns 1 if the slave acknowledged its address
+uint8_t i2c_readStart(uint8_t address)
+{
+	i2c_startCondition();
+	
+	i2c_writeByte(2*address + 1); // odd address => read
+	
+	if ((TWSR & 0xF8) != 0x40)    // no ACK received from slave after SLA+R
+	{
+		i2c_stopCondition();
+		return 0;
+	}
+	return 1;
+}
+
+// read the next bytes of a sequential read started with i2c_readStart
+// last = 1 answers the final byte with NACK and releases the bus
+uint8_t i2c_readContinue(uint8_t* buffer, uint8_t length, uint8_t last)
+{
+	uint16_t timeout = 0;
+	
+	for (uint8_t i = 0; i < length; i++)
+	{
+		if (last && (i == (length - 1)))
+		{
+			TWCR = (1 << TWINT) | (1 << TWEN);
+		}
+		else
+		{
+			TWCR = (1 << TWINT) | (1 << TWEA) | (1 << TWEN);
+		}
+		timeout = 0;
+		while (!(TWCR & (1 << TWINT)))
+		{
+			timeout++;
+			if (timeout > 50000)
+			{
+				i2c_stopCondition();
+				return 0;
+			}
+		}
+		
+		buffer[i] = TWDR;
+	}
+	
+	if (last)
+	{
+		i2c_stopCondition();
+	}
+	return 1;
+}
+
+// acknowledge received byte i of a read transfer, the last byte gets NACK unless the bus is kept
+static uint8_t i2c_xferAck(i2c_xfer* xfer, uint8_t i)
+{
+	if ((i < xfer->length - 1) || (xfer->flags & I2C_XFER_NOSTOP))
+		return (1 << TWEA);
+	return 0;
+}
+
+// begin transfer at head of queue, called with interrupts disabled
+static void i2c_xferStart(void)
+{
+	i2c_xfer* xfer = i2c_queue[i2c_head];
+
+	xfer->status = I2C_XFER_BUSY;
+	i2c_index    = 0;
+	if (!(xfer->flags & I2C_XFER_NOSTART))
+	{
+		TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN) | (1 << TWIE);    // (repeated) start condition
+	}
+	else if (xfer->flags & I2C_XFER_READ)
+	{
+		TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE) | i2c_xferAck(xfer, 0); // receive next byte
+	}
+	else
+	{
+		TWDR = xfer->buffer[i2c_index++];
+		TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);                  // send next byte
+	}
+}
+
+// finish transfer at head of queue and begin the next one, called with interrupts disabled
+static void i2c_xferFinish(uint8_t status)
+{
+	i2c_xfer* xfer  = i2c_queue[i2c_head];
+	uint8_t   flags = xfer->flags;
+
+	xfer->status = status;
+	i2c_head     = (i2c_head + 1) % I2C_QUEUE_SIZE;
+	i2c_count    = i2c_count - 1;
+
+	if (status != I2C_XFER_DONE)
+	{
+		while (i2c_count && (flags & I2C_XFER_NOSTOP))             // cancel transfers chained to the failed one
+		{
+			xfer         = i2c_queue[i2c_head];
+			flags        = xfer->flags;
+			xfer->status = status;
+			i2c_head     = (i2c_head + 1) % I2C_QUEUE_SIZE;
+			i2c_count    = i2c_count - 1;
+		}
+		flags = 0;
+	}
+
+	if (flags & I2C_XFER_NOSTOP)
+	{
+		TWCR = (1 << TWEN);                                         // keep TWINT set, SCL is held low until next transfer
+	}
+	else
+	{
+		TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+		while (TWCR & (1 << TWSTO));                                // Stop Condition sent, bus is free for next start
+	}
+
+	if (i2c_count)
+		i2c_xferStart();
+}
+
+ISR(TWI_vect)
+{
+	i2c_xfer* xfer = i2c_queue[i2c_head];
+
+	switch (TWSR & 0xF8)
+	{
+		case 0x08: // start condition sent
+		case 0x10: // repeated start condition sent
+			TWDR = 2*xfer->address + ((xfer->flags & I2C_XFER_READ) ? 1 : 0);
+			TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+			break;
+
+		case 0x18: // SLA+W sent, ACK received
+		case 0x28: // data sent, ACK received
+			if (i2c_index < xfer->length)
+			{
+				TWDR = xfer->buffer[i2c_index++];
+				TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+			}
+			else
+				i2c_xferFinish(I2C_XFER_DONE);
+			break;
+
+		case 0x40: // SLA+R sent, ACK received
+			TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE) | i2c_xferAck(xfer, 0);
+			break;
+
+		case 0x50: // data received, ACK sent
+			xfer->buffer[i2c_index++] = TWDR;
+			if (i2c_index < xfer->length)
+				TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWIE) | i2c_xferAck(xfer, i2c_index);
+			else
+				i2c_xferFinish(I2C_XFER_DONE);                      // bus is kept, see I2C_XFER_NOSTOP
+			break;
+
+		case 0x58: // data received, NACK sent
+			xfer->buffer[i2c_index++] = TWDR;
+			i2c_xferFinish(I2C_XFER_DONE);
+			break;
+
+		case 0x20: // SLA+W sent, NACK received
+		case 0x30: // data sent, NACK received
+		case 0x48: // SLA+R sent, NACK received
+			i2c_xferFinish(I2C_XFER_NACK);
+			break;
+
+		default:   // arbitration lost or bus error
+			i2c_xferFinish(I2C_XFER_ERROR);
+			break;
+	}
+}
+
+// queue a transfer for the interrupt driven engine, returns 0 if the queue is full
+uint8_t i2c_submit(i2c_xfer* xfer)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	if (i2c_count == I2C_QUEUE_SIZE)
+	{
+		SREG = sreg;
+		return 0;
+	}
+	xfer->status = I2C_XFER_QUEUED;
+	i2c_queue[(i2c_head + i2c_count) % I2C_QUEUE_SIZE] = xfer;
+	i2c_count = i2c_count + 1;
+	if (i2c_count == 1)
+		i2c_xferStart();                                            // engine was idle
+	SREG = sreg;
+	return 1;
+}
+
+// returns 1 if no transfer is queued
+uint8_t i2c_idle(void)
+{
+	return (i2c_count == 0);
+}
+
+// cancel all queued transfers and reset the TWI, used after a timeout
+void i2c_abort(void)
+{
+	uint8_t sreg = SREG;
+
+	cli();
+	TWCR = 0;                                                       // disable TWI, SDA and SCL are released
+	while (i2c_count)
+	{
+		i2c_queue[i2c_head]->status = I2C_XFER_ERROR;
+		i2c_head  = (i2c_head + 1) % I2C_QUEUE_SIZE;
+		i2c_count = i2c_count - 1;
+	}
+	SREG = sreg;
+}
+
 // check if i2c device exists on this address
 uint8_t i2c_scan(uint8_t address)
 {
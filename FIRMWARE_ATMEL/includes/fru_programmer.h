@@ -22,7 +22,7 @@
  */   
 #define FRU_PROGRAMMER_FW_REL_MAJ   0x01	/* major release, 8 bit */
 #define FRU_PROGRAMMER_FW_REL_MIN   0x01	/* minor release, 8 bit */
-#define FRU_PROGRAMMER_FW_BUILD     0x01	/* build number   8 bit */
+#define FRU_PROGRAMMER_FW_BUILD     0x09	/* build number   8 bit */
 
 /*
  * EEPROM definitions
@@ -34,6 +34,22 @@
  */
 #define F_CPU           8000000UL   // 8 MHz
 
+/*
+ * Timer definitions, timer 1 is free running with F_CPU / 64
+ */
+#define TIMER_TICK_US   8           // 8 us per timer tick
+#define TIMER_US(t)     ((t) * TIMER_TICK_US)
+
+/*
+ * Profiling phases of a command, time is counted in timer ticks
+ */
+#define PROF_USB_RX     0           // receive command and arguments from host
+#define PROF_I2C_ADDR   1           // I2C address phase (start, device and word address)
+#define PROF_I2C_DATA   2           // I2C data phase
+#define PROF_TWR        3           // ACK polling during EEPROM write cycle
+#define PROF_USB_TX     4           // send reply to host
+#define PROF_PHASES     5
+
 /*
  * LED numbers and states
  */
@@ -61,16 +77,23 @@
 #define UART_ACK  0x06
 #define UART_NACK '?'
 #define UART_END  0xFF
+#define UART_CREDIT 0x11 // XON, host may send one more chunk of a streaming write
 
 #define I2C_BUFFERSIZE    67 // 1 BYTE I2C ADDR + 2 BYTES MEM ADDR + 64 BYTES
 #define I2C_DEFAULT_READ  8  // READ 1 BYTE BY DEFAULT
 #define I2C_MAX_READ      64 // READ 32 BYTE MAX IN A BURST
 #define I2C_DEFAULT_WRITE 1  // WRITE 1 BYTE BY DEFAULT
+#define I2C_MAX_WRITE     64 // WRITE 64 BYTE MAX IN A STREAMING WRITE CHUNK
+#define I2C_TWR_TIMEOUT   (20000 / TIMER_TICK_US) // GIVE UP ACK POLLING AFTER 20 MS, tWR IS 10 MS MAX
+#define I2C_XFER_TIMEOUT  (100000 / TIMER_TICK_US) // ABORT QUEUED I2C TRANSFER AFTER 100 MS, A 64 BYTE CHUNK TAKES 6 MS AT 100 KHZ
+#define FRAME_RX_TIMEOUT  (50000 / TIMER_TICK_US) // GIVE UP RECEIVING A FRAME AFTER 50 MS WITHOUT DATA FROM HOST
+#define USB_IDLE_TIMEOUT  (200000 / TIMER_TICK_US) // GIVE UP STREAMING WRITE AFTER 200 MS WITHOUT DATA FROM HOST
 
 /*
  * helper functions
  */
 void    init_IOports(void);
+void    init_timer(void);
 void    set_led(uint8_t led_idx, uint8_t state);
 void    set_writepin(uint8_t state);
 
@@ -78,4 +101,10 @@ uint8_t get_prsnt_state(void);
 uint8_t get_wrpol_state(void);
 uint8_t get_GA_state(void);
 
+void    prof_start(void);
+void    prof_mark(uint8_t phase);
+void    prof_end(void);
+void    prof_dump(void);
+void    prof_reset(void);
+
 #endif
\ No newline at end of file
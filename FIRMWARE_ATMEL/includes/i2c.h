@@ -19,12 +19,44 @@
 
 //#define SCL_CLOCK 100000L
 
+#define I2C_QUEUE_SIZE    4      // number of transfers queued in interrupt driven engine
+
+// transfer flags
+#define I2C_XFER_READ     0x01   // read from slave, write otherwise
+#define I2C_XFER_NOSTOP   0x02   // keep bus after transfer, the next transfer follows with repeated start (or continues with I2C_XFER_NOSTART)
+#define I2C_XFER_NOSTART  0x04   // continue previous I2C_XFER_NOSTOP transfer in same direction without start condition and address
+
+// transfer status
+#define I2C_XFER_QUEUED   0x00
+#define I2C_XFER_BUSY     0x01
+#define I2C_XFER_DONE     0x02
+#define I2C_XFER_NACK     0x03   // slave did not acknowledge address or data
+#define I2C_XFER_ERROR    0x04   // bus error, arbitration lost or aborted
+
+// descriptor of a transfer for the interrupt driven engine, must stay valid until status is I2C_XFER_DONE or higher
+typedef struct
+{
+	uint8_t          address;     // 7 bit I2C address
+	uint8_t          flags;       // I2C_XFER_READ, I2C_XFER_NOSTOP, I2C_XFER_NOSTART
+	uint8_t*         buffer;      // data to send or received data
+	uint8_t          length;      // number of bytes, at least 1
+	volatile uint8_t status;      // updated by engine, see transfer status
+} i2c_xfer;
+
 void i2c_init();
+void i2c_setClock(uint8_t twbr, uint8_t twps);
 void i2c_writeByte(uint8_t data);
 void i2c_startCondition();
 void i2c_stopCondition();
 void i2c_write(uint8_t address, uint8_t* buffer, uint8_t length);
 uint8_t i2c_read(uint8_t address, uint8_t* buffer, uint8_t bytes);
+uint8_t i2c_readStart(uint8_t address);
+uint8_t i2c_readContinue(uint8_t* buffer, uint8_t length, uint8_t last);
 uint8_t i2c_scan(uint8_t address);
 
+// interrupt driven engine, blocking functions must not be used while transfers are queued
+uint8_t i2c_submit(i2c_xfer* xfer);
+uint8_t i2c_idle(void);
+void i2c_abort(void);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'protocol.h'
+// Title		: Framed protocol v2 between host and FMC FRU Programmer
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: T0009 FMC FRU EEPROM Programmer, ATMEGA32U4
+// Target IDE   : Atmel Studio 7 (Version 7.0.2397)
+// ************************************************************************
+
+#ifndef FRU_PROTOCOL_H
+#define FRU_PROTOCOL_H
+
+#include <avr/pgmspace.h>
+
+/*
+ * frame layout, requests and replies
+ *   SOF | opcode | seq | length (MSB) | length (LSB) | payload (length bytes) | CRC-8
+ * the CRC-8 (polynomial 0x07, init 0x00) covers opcode, seq, length and payload
+ * a reply carries opcode and seq of its request, the first payload byte is the status
+ * frames are not bound to USB packets, several frames may share a packet and a frame may span packets
+ */
+#define FRAME_SOF          0xA5    // start of frame, not used as legacy command
+#define FRAME_HEADER       5       // SOF, opcode, seq, length (2 bytes)
+#define FRAME_PAYLOAD_MAX  67      // 1 byte I2C addr + 2 bytes mem addr + 64 bytes data
+#define FRAME_RANGE_MAX    4096    // largest range read with one frame
+
+// status of a received frame, also first payload byte of replies
+#define FRAME_OK           0x06    // same as UART_ACK
+#define FRAME_ERROR        '?'     // same as UART_NACK, command failed
+#define FRAME_BADCRC       0x15    // CRC mismatch, rest of receive buffer is discarded
+#define FRAME_TIMEOUT      0x16    // frame incomplete
+#define FRAME_TOOLONG      0x17    // payload exceeds FRAME_PAYLOAD_MAX
+
+typedef struct
+{
+	uint8_t  opcode;
+	uint8_t  seq;                          // sequence number chosen by host, returned with reply
+	uint16_t length;                       // number of payload bytes
+	uint8_t  payload[FRAME_PAYLOAD_MAX];
+} frame_t;
+
+uint8_t crc8_update(uint8_t crc, const uint8_t* data, uint16_t length);
+uint8_t frame_receive(frame_t* frame);
+uint8_t frame_replyStart(frame_t* frame, uint16_t length);
+void    frame_write(const uint8_t* data, uint16_t length, uint8_t* crc);
+void    frame_replyEnd(uint8_t crc);
+void    frame_reply(frame_t* frame, uint8_t status, const uint8_t* data, uint16_t length);
+
+#endif
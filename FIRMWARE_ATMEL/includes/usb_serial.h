@@ -11,6 +11,7 @@ uint8_t usb_configured(void);		// is the USB port configured
 int16_t usb_serial_getchar(void);	// receive a character (-1 if timeout/error)
 uint8_t usb_serial_available(void);	// number of bytes in receive buffer
 void usb_serial_flush_input(void);	// discard any buffered input
+void usb_serial_flush_packet(void);	// discard rest of current packet only
 
 // transmitting data
 int8_t usb_serial_putchar(uint8_t c);	// transmit a character
@@ -15,6 +15,7 @@
 #include "./includes/fru_programmer.h"
 #include "./includes/usb_serial.h"
 #include "./includes/i2c.h"
+#include "./includes/protocol.h"
 
 #include <avr/pgmspace.h>  // AVR stuff
 #include <stdint.h>        // types
@@ -36,9 +37,341 @@ void init(void)
 		
 	i2c_init();
 	
+	init_timer();
+	
 	set_led(LED_ALL,LED_OFF);
 }
 
+/*
+ * ACK polling after a page write, the EEPROM does not acknowledge its address
+ * until the internal write cycle is finished
+ * returns the measured write cycle time in timer ticks, I2C_TWR_TIMEOUT if the EEPROM never answered
+ */
+uint16_t wait_write_cycle(uint8_t i2c_addr)
+{
+   uint16_t start;                     // timer value at begin of write cycle
+   uint16_t ticks;                     // elapsed timer ticks
+
+   start = TCNT1;
+   do
+   {
+      ticks = TCNT1 - start;
+      if (i2c_scan(i2c_addr) == 1)     // same start/address/status check as bus scan
+         return ticks;
+   } while (ticks < I2C_TWR_TIMEOUT);
+
+   return I2C_TWR_TIMEOUT;
+}
+
+/*
+ * Wait for a transfer queued in the interrupt driven I2C engine
+ * all queued transfers are aborted if the bus hangs
+ * returns the transfer status
+ */
+uint8_t wait_transfer(i2c_xfer* xfer)
+{
+   uint16_t start = TCNT1;             // timer value at begin of wait
+
+   while (xfer->status < I2C_XFER_DONE)
+   {
+      if ((uint16_t)(TCNT1 - start) > I2C_XFER_TIMEOUT)
+         i2c_abort();                  // sets status of all queued transfers to I2C_XFER_ERROR
+   }
+   return xfer->status;
+}
+
+/*
+ * Sequential read of an address range, sent to the host in full USB packets
+ * address bytes (1 or 2) are taken from i2c_buf, length 0 reads 65536 bytes
+ * the I2C engine reads the next chunk into the second buffer while the current chunk is sent to the host
+ * on success the host receives ACK followed by length data bytes, otherwise NACK
+ * inside a frame (crc not NULL) the reply is padded to length data bytes after NACK and crc is updated
+ */
+void read_range(uint8_t i2c_addr, uint8_t* i2c_buf, uint8_t addr_bytes, uint32_t length, uint8_t* crc)
+{
+   uint8_t  buf[2][I2C_MAX_READ];      // chunk buffers
+   i2c_xfer xfer[2];                   // chunk read transfers
+   i2c_xfer setup;                     // transfer of addr to read
+   uint8_t  k;                         // buffer of current chunk
+   uint8_t  ok;                        // I2C bus state
+   uint8_t  status;                    // first byte of reply
+
+   if (length == 0)
+      length = 65536UL;
+
+   set_writepin(WR_TOGGLE);                                          // mask read access with WR pin
+   setup.address = i2c_addr;
+   setup.flags   = I2C_XFER_NOSTOP;                                  // read follows with repeated start
+   setup.buffer  = i2c_buf;
+   setup.length  = addr_bytes;
+   i2c_submit(&setup);
+
+   k = 0;
+   xfer[k].address = i2c_addr;
+   xfer[k].buffer  = buf[k];
+   xfer[k].length  = (length > I2C_MAX_READ) ? I2C_MAX_READ : length;
+   length          = length - xfer[k].length;
+   xfer[k].flags   = I2C_XFER_READ | (length ? I2C_XFER_NOSTOP : 0); // keep bus for next chunk
+   i2c_submit(&xfer[k]);
+
+   wait_transfer(&setup);
+   prof_mark(PROF_I2C_ADDR);
+   ok     = (wait_transfer(&xfer[k]) == I2C_XFER_DONE);
+   prof_mark(PROF_I2C_DATA);
+   status = ok ? UART_ACK : UART_NACK;                               // NACK: no EEPROM on this address
+   frame_write(&status, 1, crc);
+   if (!ok)
+   {
+      if (crc)
+         length = length + xfer[k].length;                           // frame keeps announced length
+      else
+         length = 0;                                                 // no data follows NACK
+   }
+
+   while (ok)
+   {
+      if (length)                                                    // continue sequential read into other buffer
+      {
+         xfer[k^1].address = i2c_addr;
+         xfer[k^1].buffer  = buf[k^1];
+         xfer[k^1].length  = (length > I2C_MAX_READ) ? I2C_MAX_READ : length;
+         length            = length - xfer[k^1].length;
+         xfer[k^1].flags   = I2C_XFER_READ | I2C_XFER_NOSTART | (length ? I2C_XFER_NOSTOP : 0);
+         i2c_submit(&xfer[k^1]);
+      }
+      frame_write(buf[k], xfer[k].length, crc);                      // send chunk as one USB packet during next I2C read
+      prof_mark(PROF_USB_TX);
+      if (xfer[k].flags & I2C_XFER_NOSTOP)
+      {
+         k = k ^ 1;
+         ok = (wait_transfer(&xfer[k]) == I2C_XFER_DONE);
+         prof_mark(PROF_I2C_DATA);                                   // only the time the I2C read is slower than USB
+         if (!ok)
+         {
+            for (uint8_t i=0; i<xfer[k].length; i++)
+               buf[k][i] = 0xFF;                                     // bus error, keep length of reply
+            frame_write(buf[k], xfer[k].length, crc);
+         }
+      }
+      else
+         break;                                                      // last chunk sent
+   }
+   for (uint8_t i=0; i<I2C_MAX_READ; i++)
+      buf[k][i] = 0xFF;
+   while (length)                                                    // fill up reply after bus error
+   {
+      xfer[k].length = (length > I2C_MAX_READ) ? I2C_MAX_READ : length;
+      length         = length - xfer[k].length;
+      frame_write(buf[k], xfer[k].length, crc);
+   }
+   set_writepin(WR_TOGGLE);                                          // unmask read access with WR pin
+}
+
+/*
+ * Length of the next chunk of a streaming write, chunks never cross a multiple of chunk_size
+ */
+uint8_t chunk_length(uint16_t addr, uint16_t remaining, uint8_t chunk_size)
+{
+   uint16_t n = chunk_size - (addr % chunk_size);                    // bytes up to next page boundary
+
+   return (n > remaining) ? remaining : n;
+}
+
+/*
+ * Streaming write of an address range with two chunk buffers
+ * the next chunk is received from the host while the EEPROM runs the write cycle of the current one
+ * every free buffer is granted to the host with UART_CREDIT, the host sends one chunk per credit
+ * the reply starts with ACK and ends with UART_END after the last write cycle, UART_NACK on error
+ * returns the duration of the last write cycle in timer ticks
+ */
+uint16_t write_range(uint8_t i2c_addr, uint8_t addr_bytes, uint16_t addr, uint16_t length, uint8_t chunk_size)
+{
+   uint8_t  buf[2][2+I2C_MAX_WRITE];   // chunk buffers, address bytes followed by data
+   uint8_t  buf_len[2];                // number of data bytes of chunk in buffer
+   uint8_t  rx_idx     = 0;            // buffer receiving data from host
+   uint8_t  rx_n       = 0;            // bytes received into rx buffer
+   uint8_t  wr_idx     = 0;            // buffer written to EEPROM next
+   uint8_t  full       = 0;            // number of buffers waiting for I2C write
+   uint8_t  busy       = 0;            // EEPROM runs write cycle
+   uint16_t rx_addr    = addr;         // EEPROM address of chunk in rx buffer
+   uint16_t rx_left    = length;       // bytes not yet received
+   uint16_t grant_addr = addr;         // EEPROM address of next chunk to grant
+   uint16_t grant_left = length;       // bytes not yet granted
+   uint16_t twr_start  = 0;            // timer value at begin of write cycle
+   uint16_t twr        = 0;            // duration of last write cycle
+   uint16_t idle_start;                // timer value of last byte from host
+   int16_t  c;                         // received character
+   uint8_t  n;
+
+   if ((length == 0) || (chunk_size == 0) || (chunk_size > I2C_MAX_WRITE))
+   {
+      usb_serial_putchar(UART_NACK);                                 // wrong range of parameter
+      return 0;
+   }
+
+   set_writepin(WR_TOGGLE);                                          // toggle WR pin
+   usb_serial_putchar(UART_ACK);                                     // send ACK
+   for (uint8_t i=0; (i<2) && grant_left; i++)                       // grant both buffers
+   {
+      n = chunk_length(grant_addr, grant_left, chunk_size);
+      grant_addr = grant_addr + n;
+      grant_left = grant_left - n;
+      usb_serial_putchar(UART_CREDIT);
+   }
+   usb_serial_flush_output();
+   prof_mark(PROF_USB_TX);
+   buf_len[rx_idx] = chunk_length(rx_addr, rx_left, chunk_size);
+   idle_start      = TCNT1;
+
+   while (rx_left || full || busy)
+   {
+      // RECEIVE NEXT CHUNK FROM HOST INTO FREE BUFFER
+      while (rx_left && (full < 2) && ((c = usb_serial_getchar()) >= 0))
+      {
+         buf[rx_idx][addr_bytes + rx_n] = c;
+         rx_n       = rx_n + 1;
+         idle_start = TCNT1;
+         if (rx_n == buf_len[rx_idx])                                // chunk complete
+         {
+            if (addr_bytes == 2)
+               buf[rx_idx][0] = rx_addr >> 8;                        // EEPROM address (MSB)
+            buf[rx_idx][addr_bytes-1] = rx_addr & 0xFF;              // EEPROM address (LSB)
+            rx_addr = rx_addr + rx_n;
+            rx_left = rx_left - rx_n;
+            rx_n    = 0;
+            full    = full + 1;
+            rx_idx  = rx_idx ^ 1;
+            if (rx_left)
+               buf_len[rx_idx] = chunk_length(rx_addr, rx_left, chunk_size);
+         }
+      }
+      prof_mark(PROF_USB_RX);
+      if (rx_left && (full < 2) && ((uint16_t)(TCNT1 - idle_start) > USB_IDLE_TIMEOUT))
+         break;                                                      // host stopped sending
+
+      // ACK POLLING OF CURRENT WRITE CYCLE
+      if (busy)
+      {
+         twr = TCNT1 - twr_start;
+         if (i2c_scan(i2c_addr) == 1)
+            busy = 0;                                                // EEPROM is ready again
+         else if (twr >= I2C_TWR_TIMEOUT)
+            break;                                                   // EEPROM did not finish write cycle
+         prof_mark(PROF_TWR);
+      }
+
+      // WRITE NEXT CHUNK, THE BUFFER IS FREE AGAIN AFTERWARDS
+      if (!busy && full)
+      {
+         i2c_write(i2c_addr, buf[wr_idx], addr_bytes + buf_len[wr_idx]);
+         prof_mark(PROF_I2C_DATA);
+         twr_start = TCNT1;
+         busy      = 1;
+         full      = full - 1;
+         wr_idx    = wr_idx ^ 1;
+         if (grant_left)
+         {
+            n = chunk_length(grant_addr, grant_left, chunk_size);
+            grant_addr = grant_addr + n;
+            grant_left = grant_left - n;
+            usb_serial_putchar(UART_CREDIT);
+            usb_serial_flush_output();
+            prof_mark(PROF_USB_TX);
+         }
+      }
+   }
+   set_writepin(WR_TOGGLE);                                          // toggle WR pin
+
+   if (rx_left || full || busy)
+   {
+      usb_serial_flush_input();                                      // discard chunks sent in advance
+      usb_serial_putchar(UART_NACK);
+   }
+   else
+      usb_serial_putchar(UART_END);                                  // end of transmission
+   return twr;
+}
+
+/*
+ * Execute a command received as frame (protocol v2) and send the reply frame
+ * requests carry all arguments explicitly, no state like the read burst length is used
+ *   v                                            -> status, major, minor, build
+ *   r/R  i2c addr, addr (1/2 bytes), N           -> status, N data bytes
+ *   w/W  i2c addr, addr (1/2 bytes), data        -> status after EEPROM write cycle
+ *   d/D  i2c addr, addr (1/2 bytes), N (2 bytes) -> status, N data bytes (padded after error)
+ * w/W store the duration of the EEPROM write cycle in twr_ticks
+ */
+void frame_task(frame_t* frame, uint16_t* twr_ticks)
+{
+   uint8_t  addr_bytes = (frame->opcode < 'a') ? 2 : 1;              // upper case opcode: 2 byte addressing
+   uint8_t* payload    = frame->payload;
+   uint8_t  version[3] = { FRU_PROGRAMMER_FW_REL_MAJ, FRU_PROGRAMMER_FW_REL_MIN, FRU_PROGRAMMER_FW_BUILD };
+   uint8_t  i2c_buf[I2C_MAX_READ];     // read data
+   uint16_t length;                    // number of data bytes
+   uint8_t  crc;
+   uint8_t  ok;                        // I2C bus state
+
+   switch (frame->opcode)
+   {
+      case 'v':
+               frame_reply(frame, FRAME_OK, version, 3);
+               break;
+
+      case 'r':
+      case 'R':
+               length = payload[1+addr_bytes];
+               if ((frame->length != 2+addr_bytes) || (length < 1) || (length > I2C_MAX_READ))
+               {
+                  frame_reply(frame, FRAME_ERROR, 0, 0);             // wrong number or range of parameter
+                  break;
+               }
+               set_writepin(WR_TOGGLE);                              // mask read access with WR pin
+               i2c_write(payload[0], payload+1, addr_bytes);         // transmit addr to read
+               prof_mark(PROF_I2C_ADDR);
+               ok = i2c_read(payload[0], i2c_buf, length);
+               prof_mark(PROF_I2C_DATA);
+               if (ok)
+                  frame_reply(frame, FRAME_OK, i2c_buf, length);
+               else
+                  frame_reply(frame, FRAME_ERROR, 0, 0);
+               set_writepin(WR_TOGGLE);                              // unmask read access with WR pin
+               break;
+
+      case 'w':
+      case 'W':
+               if ((frame->length < 2+addr_bytes) || (frame->length > 1+addr_bytes+I2C_MAX_WRITE))
+               {
+                  frame_reply(frame, FRAME_ERROR, 0, 0);             // wrong number of parameter
+                  break;
+               }
+               set_writepin(WR_TOGGLE);                              // toggle WR pin
+               i2c_write(payload[0], payload+1, frame->length-1);    // transmit addr and data, write to EEPROM
+               prof_mark(PROF_I2C_DATA);                             // address and data are one transfer
+               *twr_ticks = wait_write_cycle(payload[0]);            // wait until EEPROM finished write cycle
+               prof_mark(PROF_TWR);
+               set_writepin(WR_TOGGLE);                              // toggle WR pin
+               frame_reply(frame, (*twr_ticks < I2C_TWR_TIMEOUT) ? FRAME_OK : FRAME_ERROR, 0, 0);
+               break;
+
+      case 'd':
+      case 'D':
+               length = (payload[1+addr_bytes] << 8) | payload[2+addr_bytes];
+               if ((frame->length != 3+addr_bytes) || (length < 1) || (length > FRAME_RANGE_MAX))
+               {
+                  frame_reply(frame, FRAME_ERROR, 0, 0);             // wrong number or range of parameter
+                  break;
+               }
+               crc = frame_replyStart(frame, 1+length);
+               read_range(payload[0], payload+1, addr_bytes, length, &crc);
+               frame_replyEnd(crc);
+               break;
+
+      default:
+               frame_reply(frame, FRAME_ERROR, 0, 0);                // unknown command
+               break;
+   }
+}
+
 int main(void)
 {
    uint8_t i;                          // default loop variable   
@@ -50,6 +383,9 @@ int main(void)
    uint8_t fru_addr_lsb;               // EEPROM target address for read/write access, LSB is not used in case of 1 byte addressing
    uint8_t fru_data;                   // EEPROM target data
    uint8_t i2c_buf[I2C_BUFFERSIZE];    // buffer for I2C bus data
+   uint16_t twr_ticks;                 // measured duration of last EEPROM write cycle
+   uint16_t length;                    // number of bytes for range commands
+   frame_t  frame;                     // command received with protocol v2
    
    init();                             // initializes hardware 
        
@@ -57,6 +393,7 @@ int main(void)
    
    bytes_to_read  = I2C_DEFAULT_READ;  // default value supported by all EEPROMs
    bytes_to_write = I2C_DEFAULT_WRITE; // default value supported by all EEPROMs
+   twr_ticks      = 0;
    
    while (1)                           // main loop
    {	
@@ -77,6 +414,7 @@ int main(void)
       if (usb_serial_available()>0)                                  // valid data is in rx buffer
       {
          set_led(LED_YELLOW,LED_ON);                                 // indicate busy state
+         prof_start();                                               // timestamp of first byte
          task = usb_serial_getchar();                                // get first byte from buffer, that code determines next task
          switch(task)                                                // decode task
          {
@@ -106,6 +444,79 @@ int main(void)
 			          }
 			          break;
 					  			 
+            case 'c': // 0x63 c = clock of I2C bus (bit rate register and prescaler)
+			          if (usb_serial_available()==2)                 // command has two arguments
+			          {
+				         i = usb_serial_getchar();                   // get bit rate register from recv buffer
+						 fru_data = usb_serial_getchar();            // get prescaler from recv buffer
+						 if (fru_data<=3)
+						 {
+							i2c_setClock(i, fru_data);
+						    usb_serial_putchar(UART_ACK);            // send ACK
+							usb_serial_putchar(TWBR);                // send current value
+							usb_serial_putchar(TWSR & 0x03);         // send current value
+						 }
+						 else
+						 {
+							usb_serial_putchar(UART_NACK);           // wrong range of parameter
+						 }
+			          }
+					  else if (usb_serial_available()==0)            // command has no argument
+					  {
+						  usb_serial_putchar(TWBR);                  // print current settings
+						  usb_serial_putchar(TWSR & 0x03);           // print current settings
+					  }
+			          else
+			          {
+				         usb_serial_putchar(UART_NACK);              // not enough data, end of transmission
+			          }
+			          break;
+
+            case 'd': // 0x64 d = dump address range with 1 byte addressing
+			          if (usb_serial_available()==4)                 // command has four arguments
+			          {
+				          i2c_addr     = usb_serial_getchar();       // get next byte from recv buffer
+				          fru_addr_msb = usb_serial_getchar();       // get next byte from recv buffer
+				          i2c_buf[0]   = fru_addr_msb;               // generate I2C data buffer
+				          length       = usb_serial_getchar() << 8;  // get length (MSB) from recv buffer
+				          length      |= usb_serial_getchar();       // get length (LSB) from recv buffer
+				          prof_mark(PROF_USB_RX);
+				          read_range(i2c_addr, (uint8_t*)i2c_buf, 1, length, 0);
+			          }
+			          else
+			          {
+				          usb_serial_putchar(UART_NACK);             // not enough data, end of transmission
+			          }
+			          break;
+
+            case 'D': // 0x44 D = Dump address range with 2 byte addressing
+			          if (usb_serial_available()==5)                 // command has five arguments
+			          {
+				          i2c_addr     = usb_serial_getchar();       // get next byte from recv buffer
+				          fru_addr_msb = usb_serial_getchar();       // get next byte from recv buffer
+				          fru_addr_lsb = usb_serial_getchar();       // get next byte from recv buffer
+				          i2c_buf[0]   = fru_addr_msb;               // generate I2C data buffer
+				          i2c_buf[1]   = fru_addr_lsb;               // generate I2C data buffer
+				          length       = usb_serial_getchar() << 8;  // get length (MSB) from recv buffer
+				          length      |= usb_serial_getchar();       // get length (LSB) from recv buffer
+				          prof_mark(PROF_USB_RX);
+				          read_range(i2c_addr, (uint8_t*)i2c_buf, 2, length, 0);
+			          }
+			          else
+			          {
+				          usb_serial_putchar(UART_NACK);             // not enough data, end of transmission
+			          }
+			          break;
+
+            case FRAME_SOF: // 0xA5 = start of frame, protocol v2
+			          i = frame_receive(&frame);
+			          prof_mark(PROF_USB_RX);
+			          if (i == FRAME_OK)
+				          frame_task(&frame, &twr_ticks);
+			          else
+				          frame_reply(&frame, i, 0, 0);              // reply with opcode and seq as far as received
+			          break;
+
             case 'f': // 0x66 f = printf 0xff
 			          usb_serial_putchar(0xFF);
                       break;
@@ -137,8 +548,11 @@ int main(void)
 				          fru_addr_msb = usb_serial_getchar();       // get next byte from recv buffer
 						  i2c_buf[0]   = fru_addr_msb;               // generate I2C data buffer
 						  set_writepin(WR_TOGGLE);                               // mask read access with WR pin
+						  prof_mark(PROF_USB_RX);
 						  i2c_write(i2c_addr, (uint8_t*)i2c_buf, 1);             // transmit adddr to read				  
+						  prof_mark(PROF_I2C_ADDR);
 						  i2c_read(i2c_addr,  (uint8_t*)i2c_buf, bytes_to_read); // read data into same buffer
+						  prof_mark(PROF_I2C_DATA);
 						  set_writepin(WR_TOGGLE);                               // unmask read access with WR pin
 						  for (i=0;i<bytes_to_read;i++)
 						     usb_serial_putchar(i2c_buf[i]);                     // send I2C readoutdata
@@ -159,8 +573,11 @@ int main(void)
 						  i2c_buf[0]   = fru_addr_msb;               // generate I2C data buffer
 						  i2c_buf[1]   = fru_addr_lsb;               // generate I2C data buffer
 						  set_writepin(WR_TOGGLE);                               // mask read access with WR pin
+						  prof_mark(PROF_USB_RX);
 						  i2c_write(i2c_addr, (uint8_t*)i2c_buf, 2);             // transmit addr to read						  
+						  prof_mark(PROF_I2C_ADDR);
 						  i2c_read(i2c_addr,  (uint8_t*)i2c_buf, bytes_to_read); // read data into same buffer
+						  prof_mark(PROF_I2C_DATA);
 						  set_writepin(WR_TOGGLE);                               // unmask read access with WR pin
 						  for (i=0;i<bytes_to_read;i++)
 						     usb_serial_putchar(i2c_buf[i]);                     // send I2C readoutdata
@@ -178,9 +595,55 @@ int main(void)
 					     if(i2c_scan(i2c_addr) == 1)                
 					        usb_serial_putchar(i2c_addr);            // print valid I2C address
 				      }
+				      prof_mark(PROF_I2C_ADDR);                      // address phase only
 				      usb_serial_putchar(UART_END);                  // end of transmission
                       break;
 					  
+            case 't': // 0x74 t = time of last EEPROM write cycle in us
+                      usb_serial_putchar(UART_ACK);                  // send ACK
+                      usb_serial_putchar(TIMER_US(twr_ticks) >> 8);  // send MSB
+                      usb_serial_putchar(TIMER_US(twr_ticks) & 0xFF);// send LSB
+                      break;
+
+            case 'T': // 0x54 T = Timing of command phases, profiling counters are reset after the dump
+                      prof_dump();
+                      break;
+
+            case 'u': // 0x75 u = upload address range with 1 byte addressing
+			          if (usb_serial_available()==5)                 // command has five arguments
+			          {
+				          i2c_addr     = usb_serial_getchar();       // get next byte from recv buffer
+				          fru_addr_msb = usb_serial_getchar();       // get next byte from recv buffer
+				          length       = usb_serial_getchar() << 8;  // get length (MSB) from recv buffer
+				          length      |= usb_serial_getchar();       // get length (LSB) from recv buffer
+				          i            = usb_serial_getchar();       // get chunk size from recv buffer
+				          prof_mark(PROF_USB_RX);
+				          twr_ticks    = write_range(i2c_addr, 1, fru_addr_msb, length, i);
+			          }
+			          else
+			          {
+				          usb_serial_putchar(UART_NACK);             // not enough data, end of transmission
+			          }
+			          break;
+
+            case 'U': // 0x55 U = Upload address range with 2 byte addressing
+			          if (usb_serial_available()==6)                 // command has six arguments
+			          {
+				          i2c_addr     = usb_serial_getchar();       // get next byte from recv buffer
+				          fru_addr_msb = usb_serial_getchar();       // get next byte from recv buffer
+				          fru_addr_lsb = usb_serial_getchar();       // get next byte from recv buffer
+				          length       = usb_serial_getchar() << 8;  // get length (MSB) from recv buffer
+				          length      |= usb_serial_getchar();       // get length (LSB) from recv buffer
+				          i            = usb_serial_getchar();       // get chunk size from recv buffer
+				          prof_mark(PROF_USB_RX);
+				          twr_ticks    = write_range(i2c_addr, 2, (fru_addr_msb << 8) | fru_addr_lsb, length, i);
+			          }
+			          else
+			          {
+				          usb_serial_putchar(UART_NACK);             // not enough data, end of transmission
+			          }
+			          break;
+
             case 'v': // 0x76 v = version of firmware
 					  usb_serial_putchar(FRU_PROGRAMMER_FW_REL_MAJ);
 					  usb_serial_putchar(FRU_PROGRAMMER_FW_REL_MIN);
@@ -192,7 +655,6 @@ int main(void)
 			          if (usb_serial_available()>=3)                 // command has at least three arguments
 			          {
 						  bytes_to_write = usb_serial_available() - 2; // get number of bytes in commando string (offset 2: 1 byte I2C addr, 1 byte mem addr)
-				          usb_serial_putchar(UART_ACK);                // send ACK
 				          i2c_addr     = usb_serial_getchar();         // get next byte from recv buffer
 				          fru_addr_msb = usb_serial_getchar();         // get next byte from recv buffer				          				  
 						  i2c_buf[0]   = fru_addr_msb;                 // generate I2C data buffer
@@ -202,8 +664,16 @@ int main(void)
 							  i2c_buf[1+i] = fru_data;                 // generate I2C data buffer
 						  }
 						  set_writepin(WR_TOGGLE);                                  // toggle WR pin
+						  prof_mark(PROF_USB_RX);
 						  i2c_write(i2c_addr, (uint8_t*)i2c_buf, 1+bytes_to_write); // transmit data and write to EEPROM
+						  prof_mark(PROF_I2C_DATA);                                 // address and data are one transfer
+						  twr_ticks = wait_write_cycle(i2c_addr);                   // wait until EEPROM finished write cycle
+						  prof_mark(PROF_TWR);
 						  set_writepin(WR_TOGGLE);                                  // toggle WR pin
+						  if (twr_ticks < I2C_TWR_TIMEOUT)
+						     usb_serial_putchar(UART_ACK);                          // send ACK, EEPROM is ready for next command
+						  else
+						     usb_serial_putchar(UART_NACK);                         // EEPROM did not finish write cycle
 			          }
 			          else
 			          {
@@ -215,7 +685,6 @@ int main(void)
 			          if (usb_serial_available()>=4)                 // command has at least four arguments
 					  {
 						 bytes_to_write = usb_serial_available() - 3; // get number of bytes in commando string (offset 3: 1 byte I2C addr, 2 byte mem addr)
-                         usb_serial_putchar(UART_ACK);                // send ACK
 			             i2c_addr     = usb_serial_getchar();         // get next byte from recv buffer
 			             fru_addr_msb = usb_serial_getchar();         // get next byte from recv buffer
 					     fru_addr_lsb = usb_serial_getchar();         // get next byte from recv buffer			             
@@ -227,8 +696,16 @@ int main(void)
 							 i2c_buf[2+i] = fru_data;                 // generate I2C data buffer
 						 }						 
 						 set_writepin(WR_TOGGLE);                                   // toggle WR pin
+						 prof_mark(PROF_USB_RX);
 						 i2c_write(i2c_addr, (uint8_t*)i2c_buf, 2+bytes_to_write);  // transmit data and write to EEPROM
+						 prof_mark(PROF_I2C_DATA);                                  // address and data are one transfer
+						 twr_ticks = wait_write_cycle(i2c_addr);                    // wait until EEPROM finished write cycle
+						 prof_mark(PROF_TWR);
 						 set_writepin(WR_TOGGLE);                                   // toggle WR pin
+						 if (twr_ticks < I2C_TWR_TIMEOUT)
+						    usb_serial_putchar(UART_ACK);                           // send ACK, EEPROM is ready for next command
+						 else
+						    usb_serial_putchar(UART_NACK);                          // EEPROM did not finish write cycle
 					  }
 					  else
 					  {
@@ -236,7 +713,13 @@ int main(void)
 					  }
                       break;					  
          } // end switch
-         usb_serial_flush_input();
+         if (task != FRAME_SOF)
+            usb_serial_flush_packet();                               // discard unused arguments, keep queued commands and frames
+         usb_serial_flush_output();                                  // send reply now, not after flush timeout
+         if (task == 'T')
+            prof_reset();                                            // counters were sent, T itself is not counted
+         else
+            prof_end();                                              // add phases of this command to counters
          set_led(LED_YELLOW,LED_OFF);
       } // end if
    } // end while(1) main loop
@@ -0,0 +1,26 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim/avr/interrupt.h'
+// Title		: Interrupt layer of the FMC FRU Programmer simulator
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host, replaces <avr/interrupt.h> of avr-libc
+// ************************************************************************
+// Interrupts are dispatched by the register layer while the I flag of SREG is set,
+// an ISR runs with the I flag cleared like on the AVR.
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector)  void vector(void)
+
+#define sei()        (SREG |=  0x80)
+#define cli()        (SREG &= ~0x80)
+
+#endif
@@ -0,0 +1,78 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim/avr/io.h'
+// Title		: Register layer of the FMC FRU Programmer simulator
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host, replaces <avr/io.h> of avr-libc
+// ************************************************************************
+// TWI registers and TCNT1 are accessed through functions, so every access
+// lets the simulated peripherals advance and pending interrupts run.
+// All other registers are plain variables.
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG;
+extern volatile uint8_t PORTB, PORTD, PORTE, PORTF;
+extern volatile uint8_t DDRB, DDRD, DDRE, DDRF;
+extern volatile uint8_t PINB, PIND, PINE, PINF;
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern volatile uint8_t EICRA, EICRB, EIMSK, EIFR;
+extern volatile uint8_t SMCR, MCUCR;
+
+volatile uint8_t*  sim_twcr(void);
+volatile uint8_t*  sim_twsr(void);
+volatile uint8_t*  sim_twdr(void);
+volatile uint8_t*  sim_twbr(void);
+volatile uint16_t* sim_tcnt1(void);
+
+#define TWCR   (*sim_twcr())
+#define TWSR   (*sim_twsr())
+#define TWDR   (*sim_twdr())
+#define TWBR   (*sim_twbr())
+#define TCNT1  (*sim_tcnt1())
+
+// TWCR
+#define TWINT  7
+#define TWEA   6
+#define TWSTA  5
+#define TWSTO  4
+#define TWWC   3
+#define TWEN   2
+#define TWIE   0
+
+// TWSR
+#define TWPS1  1
+#define TWPS0  0
+
+// TCCR1B
+#define CS12   2
+#define CS11   1
+#define CS10   0
+
+// EICRA, EICRB, EIMSK
+#define ISC61  5
+#define ISC60  4
+#define INT6   6
+
+// SMCR
+#define SM1    2
+#define SE     0
+
+#define PB6    6
+#define PD2    2
+#define PD3    3
+#define PD4    4
+#define PD5    5
+#define PE6    6
+#define PF6    6
+#define PF7    7
+
+#endif
@@ -0,0 +1,24 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim/avr/pgmspace.h'
+// Title		: Program memory access for the FMC FRU Programmer simulator
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host, replaces <avr/pgmspace.h> of avr-libc
+// ************************************************************************
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)            (s)
+#define pgm_read_byte(p)   (*(const uint8_t*)(p))
+#define pgm_read_word(p)   (*(const uint16_t*)(p))
+
+#endif
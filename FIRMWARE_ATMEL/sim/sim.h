@@ -0,0 +1,44 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim.h'
+// Title		: Simulator of the FMC FRU Programmer hardware
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host
+// ************************************************************************
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+// ENVIRONMENT VARIABLES
+// FRU_SIM_LINK      symlink created for the pseudo terminal, e.g. /tmp/ttyFRU
+// FRU_SIM_PRESENT   0: no FMC module plugged in, 1: FMC module plugged in (default)
+// FRU_SIM_GA        geographical address GA1..GA0 of the FMC module (0 .. 3, default 0)
+// FRU_SIM_WRPOL     state of WR_POL switch (0 or 1, default 0)
+// FRU_SIM_REALTIME  0: I2C transfers complete immediately, 1: I2C transfers take the time of the SCL clock (default)
+// FRU_SIM_EEPROM    EEPROM model 24C01 .. 24C512 (default 24C02)
+// FRU_SIM_EEPROM_ADDR  7 bit I2C address of EEPROM (default 0x50 | GA)
+// FRU_SIM_PAGE      page size in bytes (default of model)
+// FRU_SIM_TWR_US    duration of internal write cycle in us (default 5000)
+// FRU_SIM_IMAGE     file with EEPROM content, created if missing, updated after every write cycle
+// FRU_SIM_TIMELINE  CSV file, one line per I2C transaction, see sim_eeprom.c
+
+// register layer, sim_avr.c
+void     sim_poll(void);                                 // advance TWI and dispatch pending interrupts
+uint64_t sim_time_ns(void);                              // monotonic time since start of simulator
+int      sim_env(const char* name, int value);           // integer environment variable or default value
+
+// simulated I2C bus, implemented by the devices, sim_eeprom.c
+void     sim_i2c_init(void);                             // configure devices from environment
+uint8_t  sim_i2c_start(uint8_t address, uint8_t read);   // start condition and address byte, returns 1 on ACK
+uint8_t  sim_i2c_write(uint8_t data);                    // data byte from master, returns 1 on ACK
+uint8_t  sim_i2c_read(uint8_t ack);                      // data byte to master, ack: master acknowledges the byte
+void     sim_i2c_stop(void);                             // stop condition
+
+#endif
@@ -0,0 +1,244 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim_avr.c'
+// Title		: Register layer of the FMC FRU Programmer simulator (TWI, timer 1, GPIO)
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host
+// ************************************************************************
+
+#include "sim.h"
+
+#include <avr/io.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SIM_F_CPU     8000000          // CPU clock of the ATMEGA32U4, TWI and timer 1 are derived from it
+#define TWCR_SEEN     0x02             // reserved bit 1 of TWCR, set by the simulator, a write of the firmware clears it
+
+volatile uint8_t SREG;
+volatile uint8_t PORTB, PORTD, PORTE, PORTF;
+volatile uint8_t DDRB, DDRD, DDRE, DDRF;
+volatile uint8_t PINB, PIND, PINE, PINF;
+volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+volatile uint8_t EICRA, EICRB, EIMSK, EIFR;
+volatile uint8_t SMCR, MCUCR;
+
+void TWI_vect(void);                   // interrupt service routine of i2c.c
+
+typedef enum { BUS_IDLE, BUS_START, BUS_WRITE, BUS_READ } bus_phase;
+typedef enum { TWI_NONE, TWI_BYTE, TWI_STOP } twi_action;
+
+static volatile uint8_t  twcr;
+static volatile uint8_t  twsr;
+static volatile uint8_t  twdr;
+static volatile uint8_t  twbr;
+static volatile uint16_t tcnt1;
+
+static uint8_t    twi_status = 0xF8;   // status bits of TWSR, 0xF8: no relevant state information
+static bus_phase  twi_bus;             // phase of the I2C bus as seen by the TWI master
+static twi_action twi_pending;         // action in progress, completes at twi_done
+static uint64_t   twi_done;            // time when the action in progress completes
+static uint8_t    twi_next_status;     // TWSR status after the action in progress
+static uint8_t    twi_next_data;       // TWDR after the action in progress (received byte)
+static uint8_t    in_isr;              // interrupt service routine is running
+static int        realtime;            // I2C transfers take the time of the SCL clock
+static uint64_t   t_start;             // start of simulator
+
+uint64_t sim_time_ns(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec - t_start;
+}
+
+int sim_env(const char* name, int value)
+{
+   const char* s = getenv(name);
+
+   return (s && *s) ? (int)strtol(s, NULL, 0) : value;
+}
+
+void sim_delay_us(double us)
+{
+   struct timespec ts;
+
+   ts.tv_sec  = (time_t)(us / 1000000.0);
+   ts.tv_nsec = (long)((us - ts.tv_sec * 1000000.0) * 1000.0);
+   nanosleep(&ts, NULL);
+   sim_poll();
+}
+
+// duration of n SCL periods, SCL clockspeed = f_cpu / (16 + 2*TWBR*4^TWPS)
+static uint64_t twi_bits_ns(uint8_t n)
+{
+   uint64_t cycles = 16 + 2 * (uint64_t)twbr * (1 << (2 * (twsr & 0x03)));
+
+   return realtime ? n * cycles * 1000000000ULL / SIM_F_CPU : 0;
+}
+
+// TWCR was written by the firmware, writing 1 to TWINT starts the next action of the TWI
+static void twi_write(uint8_t value)
+{
+   uint8_t twint = twcr & (1 << TWINT);
+
+   if (!(value & (1 << TWEN)))                                       // TWI disabled, SDA and SCL are released
+   {
+      if (twi_bus != BUS_IDLE)
+         sim_i2c_stop();
+      twi_bus     = BUS_IDLE;
+      twi_pending = TWI_NONE;
+      twi_status  = 0xF8;
+      twcr        = value & ~(1 << TWINT);
+      return;
+   }
+   if (!(value & (1 << TWINT)))                                      // writing 0 to TWINT keeps the flag
+   {
+      twcr = (value & ~(1 << TWINT)) | twint;
+      return;
+   }
+
+   twcr        = value & ~(1 << TWINT);
+   twi_pending = TWI_BYTE;
+   if (value & (1 << TWSTA))                                         // (repeated) start condition
+   {
+      twi_next_status = (twi_bus == BUS_IDLE) ? 0x08 : 0x10;
+      twi_bus         = BUS_START;
+      twi_done        = sim_time_ns() + twi_bits_ns(1);
+   }
+   else if (value & (1 << TWSTO))                                    // stop condition, TWINT is not set afterwards
+   {
+      if (twi_bus != BUS_IDLE)
+         sim_i2c_stop();
+      twi_next_status = 0xF8;
+      twi_bus         = BUS_IDLE;
+      twi_pending     = TWI_STOP;
+      twi_done        = sim_time_ns() + twi_bits_ns(1);
+   }
+   else if (twi_bus == BUS_START)                                    // SLA+R or SLA+W
+   {
+      if (twdr & 0x01)
+      {
+         twi_next_status = sim_i2c_start(twdr >> 1, 1) ? 0x40 : 0x48;
+         twi_bus         = BUS_READ;
+      }
+      else
+      {
+         twi_next_status = sim_i2c_start(twdr >> 1, 0) ? 0x18 : 0x20;
+         twi_bus         = BUS_WRITE;
+      }
+      twi_done = sim_time_ns() + twi_bits_ns(9);
+   }
+   else if (twi_bus == BUS_WRITE)                                    // data byte to slave
+   {
+      twi_next_status = sim_i2c_write(twdr) ? 0x28 : 0x30;
+      twi_done        = sim_time_ns() + twi_bits_ns(9);
+   }
+   else if (twi_bus == BUS_READ)                                     // data byte from slave, TWEA acknowledges it
+   {
+      twi_next_data   = sim_i2c_read(value & (1 << TWEA) ? 1 : 0);
+      twi_next_status = (value & (1 << TWEA)) ? 0x50 : 0x58;
+      twi_done        = sim_time_ns() + twi_bits_ns(9);
+   }
+   else
+      twi_pending = TWI_NONE;                                        // no start condition, the TWI does nothing
+}
+
+// complete the action in progress when its time has come
+static void twi_update(void)
+{
+   if ((twi_pending == TWI_NONE) || (sim_time_ns() < twi_done))
+      return;
+
+   twi_status = twi_next_status;
+   if (twi_pending == TWI_STOP)
+      twcr &= ~(1 << TWSTO);
+   else
+   {
+      if (twi_bus == BUS_READ)
+         twdr = twi_next_data;
+      twcr |= (1 << TWINT);
+   }
+   twi_pending = TWI_NONE;
+}
+
+void sim_poll(void)
+{
+   if (!(twcr & TWCR_SEEN))                                          // firmware wrote TWCR since the last access
+      twi_write(twcr);
+   twi_update();
+
+   // TWI INTERRUPT, THE ISR RUNS WITH INTERRUPTS DISABLED LIKE ON THE AVR
+   while (!in_isr && (SREG & 0x80) && (twcr & (1 << TWIE)) && (twcr & (1 << TWINT)))
+   {
+      in_isr = 1;
+      SREG  &= ~0x80;
+      twcr  |= TWCR_SEEN;
+      TWI_vect();
+      SREG  |= 0x80;
+      in_isr = 0;
+      if (!(twcr & TWCR_SEEN))
+         twi_write(twcr);
+      twi_update();
+   }
+   twcr |= TWCR_SEEN;
+}
+
+volatile uint8_t* sim_twcr(void)
+{
+   sim_poll();
+   return &twcr;
+}
+
+volatile uint8_t* sim_twsr(void)
+{
+   sim_poll();
+   twsr = (twsr & 0x03) | twi_status;                                // only the prescaler bits are writable
+   return &twsr;
+}
+
+volatile uint8_t* sim_twdr(void)
+{
+   sim_poll();
+   return &twdr;
+}
+
+volatile uint8_t* sim_twbr(void)
+{
+   sim_poll();
+   return &twbr;
+}
+
+// timer 1 runs free with the prescaler selected in TCCR1B
+volatile uint16_t* sim_tcnt1(void)
+{
+   static const uint16_t prescaler[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+   uint16_t div = prescaler[TCCR1B & 0x07];
+
+   sim_poll();
+   if (div)
+      tcnt1 = (uint16_t)(sim_time_ns() / (1000000000ULL / SIM_F_CPU * div));
+   return &tcnt1;
+}
+
+// GPIO inputs and I2C devices are configured from the environment before main() of the firmware runs
+__attribute__((constructor)) static void sim_init(void)
+{
+   uint8_t ga = sim_env("FRU_SIM_GA", 0) & 0x03;
+
+   t_start  = sim_time_ns();
+   realtime = sim_env("FRU_SIM_REALTIME", 1);
+   twcr     = TWCR_SEEN;
+
+   PINE = sim_env("FRU_SIM_PRESENT", 1) ? 0 : (1 << PE6);            // PRSNT is low while the FMC module is plugged in
+   PIND = (sim_env("FRU_SIM_WRPOL", 0) ? (1 << PD5) : 0)
+        | ((ga & 0x01) ? (1 << PD3) : 0)
+        | ((ga & 0x02) ? (1 << PD2) : 0);
+
+   sim_i2c_init();
+}
@@ -0,0 +1,224 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim_eeprom.c'
+// Title		: I2C EEPROM on the simulated FMC module (24C01 .. 24C512)
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host
+// ************************************************************************
+// Behavior of the 24Cxx family as seen from the I2C bus:
+// - the word address counter wraps at the end of the array, sequential reads continue at address 0
+// - a page write rolls over to the begin of the page, later bytes overwrite earlier ones
+// - the internal write cycle starts with the stop condition, the device does not acknowledge
+//   its address until the write cycle is finished (ACK polling)
+// - 24C01 .. 24C16 use 1 byte addressing, 24C04 .. 24C16 take the upper address bits from the
+//   device address (block select) and occupy 2, 4 or 8 I2C addresses
+// - 24C32 .. 24C512 use 2 byte addressing
+// Every transaction (start to stop or repeated start) is written to the timeline file as one line:
+//    start_us,end_us,i2c_addr,dir,word_addr,bytes,result,twr_end_us
+
+#include "sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EEPROM_SIZE_MAX   65536        // 24C512
+#define EEPROM_PAGE_MAX   128          // 24C512
+
+typedef struct
+{
+   uint16_t model;                     // 24Cxx, xx = size in kbit
+   uint32_t size;                      // array size in bytes
+   uint8_t  page;                      // page size in bytes
+   uint8_t  addr_bytes;                // word address bytes
+   uint8_t  block_bits;                // upper address bits in device address
+   uint16_t twr_us;                    // maximum duration of write cycle
+} eeprom_model;
+
+static const eeprom_model models[] =
+{
+   {   1,   128,   8, 1, 0, 5000 },
+   {   2,   256,   8, 1, 0, 5000 },
+   {   4,   512,  16, 1, 1, 5000 },
+   {   8,  1024,  16, 1, 2, 5000 },
+   {  16,  2048,  16, 1, 3, 5000 },
+   {  32,  4096,  32, 2, 0, 5000 },
+   {  64,  8192,  32, 2, 0, 5000 },
+   { 128, 16384,  64, 2, 0, 5000 },
+   { 256, 32768,  64, 2, 0, 5000 },
+   { 512, 65536, 128, 2, 0, 5000 },
+};
+
+static eeprom_model dev;                        // configured device
+static uint8_t      eeprom[EEPROM_SIZE_MAX];    // memory array
+static uint8_t      page[EEPROM_PAGE_MAX];      // page buffer of a write transaction
+static uint8_t      page_valid[EEPROM_PAGE_MAX];
+static uint32_t     page_base;                  // array address of page buffer
+static uint8_t      i2c_addr;                   // 7 bit address, block select bits are 0
+static uint8_t      block_mask;                 // block select bits of 7 bit address
+static uint32_t     addr;                       // word address counter
+static uint64_t     busy_until;                 // end of internal write cycle
+static FILE*        image;                      // backing file of memory array, NULL: none
+static FILE*        timeline;                   // transaction log, NULL: none
+
+static struct                                   // current transaction
+{
+   uint8_t  active;                             // start condition seen
+   uint8_t  selected;                           // device acknowledged its address
+   uint8_t  released;                           // master did not acknowledge a read byte, device releases SDA
+   uint8_t  read;                               // read transaction
+   uint8_t  address;                            // 7 bit address sent by master
+   uint8_t  addr_count;                         // word address bytes received
+   uint32_t first_addr;                         // word address of first data byte
+   uint32_t bytes;                              // data bytes transferred
+   uint64_t start;                              // time of start condition
+} t;
+
+// finish current transaction and write it to the timeline
+static void transaction_end(uint8_t stop)
+{
+   const char* result;
+   uint64_t    twr_end = 0;
+
+   if (!t.active)
+      return;
+   if (!t.selected)
+      result = (t.address & ~block_mask) == i2c_addr ? "busy" : "nack";
+   else if (!t.read && stop && t.bytes)                                 // stop starts the internal write cycle
+   {
+      for (uint8_t i = 0; i < dev.page; i++)
+         if (page_valid[i])
+            eeprom[page_base + i] = page[i];
+      if (image)
+      {
+         fseek(image, page_base, SEEK_SET);
+         fwrite(eeprom + page_base, 1, dev.page, image);
+         fflush(image);
+      }
+      busy_until = sim_time_ns() + dev.twr_us * 1000ULL;
+      twr_end    = busy_until;
+      result     = "write";
+   }
+   else
+      result = t.read ? "read" : "addr";
+
+   if (timeline)
+      fprintf(timeline, "%llu,%llu,0x%02X,%c,0x%04X,%u,%s,%llu\n",
+              (unsigned long long)(t.start / 1000), (unsigned long long)(sim_time_ns() / 1000),
+              t.address, t.read ? 'R' : 'W', t.first_addr, t.bytes, result,
+              (unsigned long long)(twr_end / 1000));
+   t.active = 0;
+}
+
+void sim_i2c_init(void)
+{
+   const char* name = getenv("FRU_SIM_EEPROM");
+   const char* file = getenv("FRU_SIM_IMAGE");
+   const char* log  = getenv("FRU_SIM_TIMELINE");
+   const char* p    = name ? name + strlen(name) : NULL;
+   long        model;
+
+   while (p && (p > name) && (p[-1] >= '0') && (p[-1] <= '9'))
+      p--;                                                              // size in kbit is the trailing number, 24C02 or 24LC02
+   model = (p && *p) ? strtol(p, NULL, 10) : 2;
+   dev   = models[1];                                                   // 24C02 if model is unknown
+   for (uint8_t i = 0; i < sizeof(models) / sizeof(models[0]); i++)
+      if (models[i].model == model)
+         dev = models[i];
+   dev.page   = sim_env("FRU_SIM_PAGE", dev.page);
+   dev.twr_us = sim_env("FRU_SIM_TWR_US", dev.twr_us);
+   if ((dev.page == 0) || (dev.page > EEPROM_PAGE_MAX) || (dev.page & (dev.page - 1)))
+      dev.page = EEPROM_PAGE_MAX;
+
+   block_mask = (1 << dev.block_bits) - 1;
+   i2c_addr   = sim_env("FRU_SIM_EEPROM_ADDR", 0x50 | (sim_env("FRU_SIM_GA", 0) & 0x03)) & ~block_mask;
+
+   memset(eeprom, 0xFF, sizeof(eeprom));                                // erased state
+   if (file && *file)
+   {
+      image = fopen(file, "r+b");
+      if (!image)
+         image = fopen(file, "w+b");
+      if (!image)
+         perror(file);
+      else if (fread(eeprom, 1, dev.size, image) < dev.size)
+      {
+         fseek(image, 0, SEEK_SET);                                     // file is short, store complete array
+         fwrite(eeprom, 1, dev.size, image);
+         fflush(image);
+      }
+   }
+   if (log && *log)
+   {
+      timeline = fopen(log, "w");
+      if (!timeline)
+         perror(log);
+      else
+      {
+         setvbuf(timeline, NULL, _IOLBF, 0);                            // complete lines if the simulator is killed
+         fprintf(timeline, "start_us,end_us,i2c_addr,dir,word_addr,bytes,result,twr_end_us\n");
+      }
+   }
+   printf("EEPROM 24C%02u at 0x%02X: %u bytes, page %u bytes, %u byte addressing, tWR %u us\n",
+          dev.model, i2c_addr, dev.size, dev.page, dev.addr_bytes, dev.twr_us);
+}
+
+uint8_t sim_i2c_start(uint8_t address, uint8_t read)
+{
+   transaction_end(0);                                                  // repeated start
+   memset(&t, 0, sizeof(t));
+   t.active   = 1;
+   t.start    = sim_time_ns();
+   t.address  = address;
+   t.read     = read;
+   t.selected = ((address & ~block_mask) == i2c_addr) && (sim_time_ns() >= busy_until);
+   t.first_addr = addr;
+   return t.selected;
+}
+
+uint8_t sim_i2c_write(uint8_t data)
+{
+   if (!t.selected || t.read)
+      return 0;
+   if (t.addr_count < dev.addr_bytes)
+   {
+      if (dev.block_bits)
+         addr = ((t.address & block_mask) << 8) | data;                 // block select bits are the upper address bits
+      else
+         addr = ((addr << 8) | data) & (dev.size - 1);                  // address bytes are shifted into the counter
+      t.addr_count = t.addr_count + 1;
+      t.first_addr = addr;
+      page_base    = addr & ~(uint32_t)(dev.page - 1);
+      memset(page_valid, 0, sizeof(page_valid));
+      return 1;
+   }
+   page[addr - page_base]       = data;
+   page_valid[addr - page_base] = 1;
+   addr    = page_base | ((addr + 1) & (dev.page - 1));                // roll over within the page
+   t.bytes = t.bytes + 1;
+   return 1;
+}
+
+uint8_t sim_i2c_read(uint8_t ack)
+{
+   uint8_t data;
+
+   if (!t.selected || !t.read || t.released)
+      return 0xFF;                                                      // bus is pulled up
+   data    = eeprom[addr];
+   addr    = (addr + 1) & (dev.size - 1);                               // sequential read wraps at end of array
+   t.bytes = t.bytes + 1;
+   if (!ack)
+      t.released = 1;                                                   // no more data until next start
+   return data;
+}
+
+void sim_i2c_stop(void)
+{
+   transaction_end(1);
+}
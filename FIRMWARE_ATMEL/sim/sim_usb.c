@@ -0,0 +1,176 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim_usb.c'
+// Title		: USB CDC endpoint of the FMC FRU Programmer simulator
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host, replaces usb_serial.c
+// ************************************************************************
+// The CDC endpoint is a pseudo terminal, the host tool opens its slave side like a COM port.
+// One read() of up to 64 bytes is one USB packet. A pseudo terminal does not keep the boundaries
+// of the host's writes, commands sent back to back without waiting for the reply may end up
+// in one packet.
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include "sim.h"
+#include "../includes/usb_serial.h"
+
+#include <avr/io.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define CDC_PACKET_SIZE  64            // size of bulk endpoints
+#define CDC_IDLE_MS      1             // main loop waits this long for a packet, instead of spinning
+
+static int     pty = -1;               // master side of pseudo terminal
+static int     pty_slave = -1;         // kept open, the master does not see a hangup while the host tool is not connected
+static uint8_t rx_buf[CDC_PACKET_SIZE];
+static uint8_t rx_len;                 // bytes in current packet
+static uint8_t rx_pos;                 // bytes taken from current packet
+static uint8_t tx_buf[CDC_PACKET_SIZE];
+static uint8_t tx_len;                 // bytes waiting for transmission
+
+void usb_init(void)
+{
+   struct termios tio;
+   const char*    name;
+   const char*    link;
+
+   pty = posix_openpt(O_RDWR | O_NOCTTY);
+   if ((pty < 0) || grantpt(pty) || unlockpt(pty) || !(name = ptsname(pty)))
+   {
+      perror("pseudo terminal");
+      exit(1);
+   }
+   pty_slave = open(name, O_RDWR | O_NOCTTY);
+   if ((pty_slave < 0) || tcgetattr(pty_slave, &tio))
+   {
+      perror(name);
+      exit(1);
+   }
+   cfmakeraw(&tio);                                                  // binary data, no echo
+   tcsetattr(pty_slave, TCSANOW, &tio);
+   fcntl(pty, F_SETFL, fcntl(pty, F_GETFL) | O_NONBLOCK);
+
+   link = getenv("FRU_SIM_LINK");
+   if (link && *link)
+   {
+      unlink(link);
+      if (symlink(name, link))
+         perror(link);
+   }
+   printf("FMC FRU Programmer simulator on %s\n", (link && *link) ? link : name);
+   fflush(stdout);
+
+   SREG |= 0x80;                                                     // usb_serial.c enables interrupts
+}
+
+uint8_t usb_configured(void)
+{
+   return (pty >= 0);
+}
+
+// receive next packet if the current one is used up, waits up to timeout_ms for the host
+static uint8_t rx_packet(int timeout_ms)
+{
+   struct pollfd pfd = { pty, POLLIN, 0 };
+   ssize_t       n;
+
+   if (rx_pos < rx_len)
+      return 1;
+   rx_pos = 0;
+   rx_len = 0;
+   if (tx_len)
+      usb_serial_flush_output();                                     // like the SOF flush timer of usb_serial.c
+   if (timeout_ms && (poll(&pfd, 1, timeout_ms) <= 0))
+      return 0;
+   n = read(pty, rx_buf, CDC_PACKET_SIZE);
+   if (n > 0)
+      rx_len = n;
+   sim_poll();
+   return (rx_len > 0);
+}
+
+int16_t usb_serial_getchar(void)
+{
+   if (!rx_packet(0))
+      return -1;
+   return rx_buf[rx_pos++];
+}
+
+uint8_t usb_serial_available(void)
+{
+   rx_packet(CDC_IDLE_MS);
+   return rx_len - rx_pos;
+}
+
+void usb_serial_flush_input(void)
+{
+   rx_pos = 0;
+   rx_len = 0;
+   while (read(pty, rx_buf, CDC_PACKET_SIZE) > 0)
+      ;
+}
+
+void usb_serial_flush_packet(void)
+{
+   rx_pos = rx_len;
+}
+
+int8_t usb_serial_putchar(uint8_t c)
+{
+   tx_buf[tx_len++] = c;
+   if (tx_len == CDC_PACKET_SIZE)
+      usb_serial_flush_output();                                     // packet is full
+   return 0;
+}
+
+int8_t usb_serial_putchar_nowait(uint8_t c)
+{
+   return usb_serial_putchar(c);
+}
+
+int8_t usb_serial_write(const uint8_t *buffer, uint16_t size)
+{
+   while (size--)
+      usb_serial_putchar(*buffer++);
+   return 0;
+}
+
+void usb_serial_flush_output(void)
+{
+   struct pollfd pfd = { pty, POLLOUT, 0 };
+   uint8_t       sent = 0;
+   ssize_t       n;
+
+   while (sent < tx_len)
+   {
+      n = write(pty, tx_buf + sent, tx_len - sent);
+      if (n > 0)
+         sent = sent + n;
+      else if ((n < 0) && (errno == EAGAIN))
+         poll(&pfd, 1, -1);                                          // host is not reading, wait like a full IN endpoint
+      else
+         break;
+   }
+   tx_len = 0;
+}
+
+uint32_t usb_serial_get_baud(void)      { return 115200; }
+uint8_t  usb_serial_get_stopbits(void)  { return USB_SERIAL_1_STOP; }
+uint8_t  usb_serial_get_paritytype(void){ return USB_SERIAL_PARITY_NONE; }
+uint8_t  usb_serial_get_numbits(void)   { return 8; }
+uint8_t  usb_serial_get_control(void)   { return USB_SERIAL_DTR | USB_SERIAL_RTS; }
+int8_t   usb_serial_set_control(uint8_t signals) { (void)signals; return 0; }
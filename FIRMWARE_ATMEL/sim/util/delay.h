@@ -0,0 +1,22 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	: 'sim/util/delay.h'
+// Title		: Busy wait delays for the FMC FRU Programmer simulator
+// Company		: IAM Electronic GmbH
+// Author		: PFH
+// Created		: 19-MARCH-2020
+// Target HW	: Linux host, replaces <util/delay.h> of avr-libc
+// ************************************************************************
+
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+void sim_delay_us(double us);
+
+#define _delay_ms(ms)  sim_delay_us((ms) * 1000.0)
+#define _delay_us(us)  sim_delay_us(us)
+
+#endif
@@ -300,6 +300,10 @@ static volatile uint8_t usb_configuration=0;
 static volatile uint8_t transmit_flush_timer=0;
 static uint8_t transmit_previous_timeout=0;
 
+// non-zero while the receive packet of the last getchar is
+// partially read and not yet released
+static uint8_t receive_packet_open=0;
+
 // serial port settings (baud rate, control signals, etc) set
 // by the PC.  These are ignored, but kept in RAM.
 static uint8_t cdc_line_coding[7]={0x00, 0xE1, 0x00, 0x00, 0x00, 0x00, 0x08};
@@ -362,8 +366,12 @@ int16_t usb_serial_getchar(void)
 	}
 	// take one byte out of the buffer
 	c = UEDATX;
+	receive_packet_open = 1;
 	// if buffer completely used, release it
-	if (!(UEINTX & (1<<RWAL))) UEINTX = 0x6B;
+	if (!(UEINTX & (1<<RWAL))) {
+		UEINTX = 0x6B;
+		receive_packet_open = 0;
+	}
 	SREG = intr_state;
 	return c;
 }
@@ -399,6 +407,26 @@ void usb_serial_flush_input(void)
 		while ((UEINTX & (1<<RWAL))) {
 			UEINTX = 0x6B; 
 		}
+		receive_packet_open = 0;
+		SREG = intr_state;
+	}
+}
+
+// discard the unread rest of the packet the last character was
+// taken from.  Packets received after it stay buffered, so the
+// host may queue several commands without waiting for replies.
+void usb_serial_flush_packet(void)
+{
+	uint8_t intr_state;
+
+	if (usb_configuration) {
+		intr_state = SREG;
+		cli();
+		if (receive_packet_open) {
+			UENUM = CDC_RX_ENDPOINT;
+			if (UEINTX & (1<<RWAL)) UEINTX = 0x6B;
+			receive_packet_open = 0;
+		}
 		SREG = intr_state;
 	}
 }
@@ -10,7 +10,7 @@
 // Created		  : 19-MARCH-2020
 // Last modified : 19-MARCH-2020
 // Target HW	  : T0009 FMC FRU Programmer
-// Target OS     : Windows
+// Target OS     : Windows, POSIX with posix/windows.h
 // ************************************************************************
 #include <windows.h>
 #include <math.h>
@@ -18,43 +18,264 @@
 
 #define REVISION_MAJOR 1
 #define REVISION_MINOR 1
-#define BUILD_NUMBER   1
+#define BUILD_NUMBER   8
 
 #define WIN_COM_PORT_MAX_NO 255  // this will be the maximum number for scanning COM ports, COM0, ..., COMn, ..., COMmax
 
 #define TX_BUFFER_SIZE 128       // default buffer size for TX bufer (UART communication)
 #define RX_BUFFER_SIZE 128       // default buffer size for RX bufer (UART communication)
+#define RX_TIMEOUT_MS  100       // hard deadline for a complete reply, only reached in error cases
+
+#define UART_ACK  0x06           // acknowledge character returned by FMC FRU Programmer
+#define UART_NACK '?'            // not acknowledge character returned by FMC FRU Programmer
+#define UART_END  0xFF           // end of transmission character returned by FMC FRU Programmer
+#define UART_CREDIT 0x11         // FMC FRU Programmer is able to receive one more chunk of a streaming write
+
+#define READ_DEPTH_DEFAULT 4     // default number of read commands in flight during download
+#define READ_DEPTH_MAX     32    // maximum number of read commands in flight during download
+
+#define WRITE_BURST_MAX    32    // largest power of 2 that fits into one USB packet with W command header
+#define STREAM_BURST_MAX   64    // chunk buffer size of FMC FRU Programmer during streaming write
+#define STREAM_RANGE_MAX   32768 // largest page aligned range of one u/U command
+
+#define FW_VERSION(maj,min,build) (((maj) << 16) | ((min) << 8) | (build))
+#define FW_PIPELINE FW_VERSION(1,1,2)  // first firmware keeping queued commands in its receive buffer
+#define FW_ACKPOLL  FW_VERSION(1,1,3)  // first firmware acknowledging writes after the EEPROM write cycle
+#define FW_BULKREAD FW_VERSION(1,1,4)  // first firmware supporting d/D range read command
+#define FW_STREAMWRITE FW_VERSION(1,1,5) // first firmware supporting u/U streaming write command
+#define FW_I2CCLOCK FW_VERSION(1,1,6)  // first firmware supporting c command for the I2C clock
+#define FW_FRAMES   FW_VERSION(1,1,8)  // first firmware supporting framed protocol v2
+#define FW_PROFILE  FW_VERSION(1,1,9)  // first firmware supporting T command for profiling counters
+
+#define FRAME_SOF        0xA5    // start of frame: SOF, opcode, seq, length (MSB, LSB), payload, CRC-8
+#define FRAME_HEADER     5       // SOF, opcode, seq, length (2 bytes)
+#define FRAME_RANGE_MAX  4096    // largest range read with one frame
+#define FRAME_RETRIES    3       // number of retries after a corrupted reply
+#define FRAME_OK         0x06    // frame received, same as UART_ACK
+#define FRAME_BADCRC     0x15    // CRC mismatch
+#define FRAME_TIMEOUT    0x16    // frame incomplete
+#define FRAME_TOOLONG    0x17    // payload does not fit into buffer
+#define FRAME_MISMATCH   0x18    // reply does not belong to request (opcode or seq)
+
+#define PROGRAMMER_F_CPU   8000000 // CPU clock of FMC FRU Programmer, the I2C clock is derived from it
+#define I2C_CLOCK_DEFAULT  100     // I2C clock in kHz after reset of FMC FRU Programmer, supported by all EEPROMs
+#define PROBE_BYTES        256     // bytes compared at every step of the I2C clock probe
+
+#define PROF_PHASES 5            // phases of a command profiled by FMC FRU Programmer: USB receive, I2C address, I2C data, write cycle, USB transmit
+
+#define BULK_CHUNK  1024         // bytes per ReadFile call during range read, granularity of progress output
+
+#define STATS_BUCKETS      24      // latency histogram of --stats, bucket i counts latencies below 16 us * 2^i, the last one all above
+#define STATS_PENDING      64      // commands without reply, more than READ_DEPTH_MAX
+#define STATS_FRAME        256     // command type of frames is STATS_FRAME + opcode
+#define STATS_DATA         -1      // data that belongs to the previous command, e.g. chunks of a streaming write
+
+#define TRACE_MAGIC        "FRUTRACE" // first bytes of a trace file of -t, followed by TRACE_VERSION and the records
+#define TRACE_VERSION      1
+#define TRACE_HEADER       7       // record header: type, us since previous record (4 bytes), data length (2 bytes), all LSB first
+#define TRACE_OPEN         'O'     // serial port opened, data is the port name
+#define TRACE_CLOSE        'C'     // serial port closed
+#define TRACE_TX           'W'     // bytes sent to FMC FRU Programmer
+#define TRACE_RX           'R'     // bytes received from FMC FRU Programmer
+
+#define BENCH_LATENCY_MAX  65536   // command latencies recorded per benchmark run
+#define BENCH_RESULTS_MAX  128     // benchmark runs per report
+#define BENCH_SIZE_MIN     256     // smallest transfer size of benchmark, sizes grow by BENCH_SIZE_STEP up to the EEPROM size
+#define BENCH_SIZE_STEP    16
 
 #define BADCH   (int)'?'
 #define BADARG  (int)':'
 #define EMSG    ""
 
-int           d_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char read_burst, char* filename);  // command line option: -d
-int           u_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char write_burst, char* filename); // command line option: -u
+typedef struct
+{
+   unsigned int  addr;           // EEPROM start address of write command
+   unsigned char N;              // number of bytes written by write command
+} write_op;
+
+enum { PHASE_DISCOVERY, PHASE_SCAN, PHASE_AUTODETECT, PHASE_TRANSFER, PHASE_N };
+
+typedef struct
+{
+   unsigned int       commands;              // commands sent
+   unsigned int       replies;               // replies received completely
+   unsigned int       timeouts;              // ReadFile calls that returned without data
+   unsigned int       retries;               // commands sent again after a corrupted reply
+   unsigned long long tx_bytes;              // bytes sent, including data of streaming writes
+   unsigned long long rx_bytes;              // bytes received
+   double             latency_sum;           // us from sending a command to the end of its reply
+   double             latency_max;
+   unsigned int       histogram[STATS_BUCKETS];
+} cmd_stats;
+
+typedef struct
+{
+   double             seconds;               // duration of phase
+   double             read_seconds;          // time spent waiting in ReadFile
+   double             sleep_seconds;         // time spent in Sleep
+   unsigned int       commands;
+   unsigned int       timeouts;
+   unsigned long long tx_bytes;
+   unsigned long long rx_bytes;
+} phase_stats;
+
+typedef struct
+{
+   char*              filename;              // JSON report
+   cmd_stats          cmd[2*STATS_FRAME];    // indexed by command byte, frames by STATS_FRAME + opcode
+   phase_stats        phase[PHASE_N];
+   int                current;               // current phase
+   double             t_phase;               // begin of current phase
+   int                last;                  // command type of last command sent
+   int                pending_cmd[STATS_PENDING];    // commands without reply, oldest first
+   double             pending_time[STATS_PENDING];   // send times
+   unsigned char      pending_timeout[STATS_PENDING];// ReadFile returned without data while waiting for the reply
+   int                head;                  // index of oldest pending command
+   int                N_pending;             // number of pending commands
+} host_stats;
+
+typedef struct
+{
+   unsigned char      type;                  // TRACE_OPEN, TRACE_CLOSE, TRACE_TX, TRACE_RX
+   double             t;                     // us since begin of trace
+   int                N;                     // data bytes
+   unsigned char*     data;
+   double             t_replay;              // TRACE_TX: time the host finished sending the record during replay
+} trace_rec;
+
+typedef struct
+{
+   FILE*              fp;                    // trace file of -t
+   double             t_last;                // time of last record
+} trace_log;
+
+typedef struct
+{
+   trace_rec*         rec;                   // all records of the trace file of -y
+   int                N_rec;
+   double             scale;                 // factor for recorded delays, 0: no delays
+   int                next;                  // first record after the last port session
+   int                open;                  // TRACE_OPEN record of current session, -1: port closed
+   int                end;                   // first record after current session
+   int                tx_pos;                // next record to compare with bytes sent by the host
+   int                tx_off;
+   int                rx_pos;                // next record with bytes for the host
+   int                rx_off;
+   double             t_open;                // time the port was opened during replay
+   int                diverged;              // host sent other bytes than recorded, FMC FRU Programmer stays quiet
+} replay_log;
+
+typedef struct
+{
+   double*       latency;        // latency of every command in us
+   int           N;              // number of recorded latencies
+   int           commands;       // number of commands, also counted beyond BENCH_LATENCY_MAX
+} bench_log;
+
+typedef struct
+{
+   const char*   op;             // download, upload or verify
+   const char*   method;         // read, range, frames, write or stream
+   unsigned char burst;          // read or write burst length, 0: not applicable
+   unsigned char N_addr;         // address width
+   unsigned int  eeprom_bytes;   // EEPROM size
+   unsigned int  bytes;          // transfer size
+   double        seconds;        // duration of transfer
+   int           commands;       // number of commands
+   double        p50_us;         // median command latency
+   double        p99_us;         // 99th percentile of command latency
+   int           ok;             // data read back correctly
+} bench_result;
+
+int           d_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char read_burst, int read_depth, char* filename); // command line option: -d
+int           u_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char write_burst, unsigned int page_size, char* filename); // command line option: -u
+int           U_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char write_burst, unsigned int page_size,
+                     unsigned char read_burst, int read_depth, char* filename);                                                                         // command line option: -U
+int           x_task(unsigned int N_bytes, unsigned char write_burst, unsigned int page_size, char* filename);                                      // command line option: -x
+int           k_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int N_bytes, char* clock);                                // command line option: -k
+int           B_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned int page_size, int read_depth, char* filename); // command line option: -B
 unsigned char i_task(HANDLE* hComm);                                                                                                                  // command line option: -i
 int           m_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes);                                            // command line option: -m
 unsigned char p_task(HANDLE* hComm);                                                                                                                  // command line option: -p
+int           T_task(HANDLE* hComm);                                                                                                                  // command line option: -T
 int           s_task(HANDLE* hComm);                                                                                                                  // command line option: -s
 unsigned char r_task(HANDLE* hComm, unsigned char read_burst);                                                                                        // command line option: -r
 unsigned char w_task(HANDLE* hComm, unsigned char write_burst);                                                                                       // command line option: -w
 
 int init_serial_port(unsigned char n, HANDLE* hComport);
+int open_serial_port(char* portname, HANDLE* hComport);
+int read_reply(HANDLE* hComm, unsigned char* rxbuffer, int N_expected, int* read_N);                      // read a reply with known length
+int read_reply_until(HANDLE* hComm, unsigned char* rxbuffer, int N_max, unsigned char end, int* read_N);  // read a reply terminated by end character
 
 void read_from_eeprom(unsigned char i2c_addr, unsigned char addr, unsigned char* rxbuffer, int* read_N, HANDLE* hComm); // 1 byte addressing read command
 void Read_from_eeprom(unsigned char i2c_addr, unsigned int addr, unsigned char* rxbuffer, int* read_N, HANDLE* hComm);  // 2 byte addressing Read command
+void send_read_command(unsigned char i2c_addr, unsigned char N_addr, unsigned int addr, HANDLE* hComm);                  // r/R command without waiting for the reply
+unsigned int read_image(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int N_bytes, unsigned char read_burst, int read_depth, unsigned char* image); // pipelined EEPROM readout
+unsigned int read_commands(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int N_bytes, unsigned char read_burst, int read_depth, unsigned char* image); // pipelined r/R commands
+unsigned int read_range(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int addr, unsigned int N_bytes, unsigned char* image); // d/D range read command
+unsigned int read_frames(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int N_bytes, int read_depth, unsigned char* image); // pipelined d/D frames
+
+unsigned char crc8(unsigned char crc, unsigned char* data, int N);                                                     // CRC-8 of protocol v2 frames
+void send_frame(HANDLE* hComm, unsigned char opcode, unsigned char seq, unsigned char* payload, int N);                 // send request frame
+int  read_frame(HANDLE* hComm, unsigned char opcode, unsigned char seq, unsigned char* payload, int N_max, int* N);    // receive reply frame
+void drain_input(HANDLE* hComm);                                                                                       // discard replies until programmer is quiet
 
 void write_to_eeprom(unsigned char i2c_addr, unsigned char addr, unsigned char txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm); // 1 byte addressing write command with rx buffer for ACK/NACK return
 void Write_to_eeprom(unsigned char i2c_addr, unsigned int addr, unsigned char txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm);  // 2 byte addressing write command with rx buffer for ACK/NACK return
 void write_to_eeprom_burst(unsigned char i2c_addr, unsigned char addr, unsigned char* txbyte, unsigned char N_txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm); // 1 byte addressing burst write command with rx buffer for ACK/NACK return
 void Write_to_eeprom_burst(unsigned char i2c_addr, unsigned int addr, unsigned char* txbyte, unsigned char N_txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm); // 2 byte addressing burst write command with rx buffer for ACK/NACK return
 
+unsigned int write_range(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int addr, unsigned char* data, unsigned int N_bytes, unsigned char burst); // u/U streaming write command
+unsigned int write_cycle_time(HANDLE* hComm);                                                      // measured duration of last EEPROM write cycle in us
+unsigned int set_i2c_clock(HANDLE* hComm, unsigned int khz);                                       // set I2C clock, returns the clock reached in kHz
+unsigned int i2c_clock_khz(unsigned char twbr, unsigned char twps);                                // I2C clock in kHz for TWI bit rate register and prescaler
+
+int            plan_writes(unsigned int N_image, unsigned int page_size, unsigned char max_burst, write_op* plan, int max_ops); // split image into page aligned write commands
+unsigned char  write_burst_length(unsigned int page_size, unsigned char max_burst);                                     // largest write command of a plan
+unsigned int   default_page_size(unsigned int N_bytes);                                                                  // smallest page size of EEPROMs with N_bytes size
+int            write_image(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned char* image, write_op* plan, int N_ops, unsigned char burst); // execute write plan
+int            write_commands(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned char* image, write_op* plan, int N_ops);   // execute write plan with w/W commands
+int            write_streams(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned char* image, write_op* plan, int N_ops, unsigned char burst); // execute write plan with u/U commands
+int            diff_plan(unsigned char* image, unsigned char* eeprom, write_op* plan, int N_ops);                       // drop write commands for unchanged data
+int            count_pages(write_op* plan, int N_ops, unsigned int page_size);                                           // number of EEPROM pages touched by plan
+unsigned char* load_image(char* filename, unsigned int* filesize);                                                       // read file into memory
+
 int TestIfSizeIs(unsigned int n, unsigned char i2c_addr, unsigned char addressing, HANDLE* hComm); // checks address overflow during write access on i2c device
 int readOk(unsigned char* rxbuffer, int read_N);                                                   // parse rxbuffer for read ACK
 int writeOk(unsigned char* rxbuffer, int read_N);                                                  // parse rxbuffer for write ACK
 
+double time_us(void);                                                                              // high resolution time stamp in us
+void   bench_command(double t_sent);                                                               // record latency of a command sent at t_sent
+void   bench_stats(bench_log* log, bench_result* result, double t_start);                          // duration and latency percentiles of a benchmark run
+int    bench_report(bench_result* results, int N_results, char* filename);                         // write benchmark results as CSV or JSON
+
+HANDLE port_open(char* portname);                                                                  // CreateFile with 115200 8N1 and RX_TIMEOUT_MS deadline
+void   port_close(HANDLE* hComm);                                                                  // CloseHandle
+BOOL   port_write(HANDLE* hComm, void* data, int N, int* write_N, int cmd);                        // WriteFile, cmd is the command type for --stats
+BOOL   port_read(HANDLE* hComm, void* data, int N, DWORD* read_N);                                 // ReadFile
+void   port_sleep(DWORD ms);                                                                       // Sleep
+void   stats_reply(void);                                                                          // reply of oldest command without reply is complete
+void   stats_retry(int cmd);                                                                       // command is sent again
+void   stats_flush(void);                                                                          // replies of commands without reply are discarded
+void   stats_phase(int phase);                                                                     // begin of next phase
+int    stats_report(void);                                                                         // write statistics as JSON
+int    trace_open(char* filename);                                                                 // start recording all serial port traffic
+void   trace_record(unsigned char type, void* data, int N);                                        // append record to trace file
+int    replay_load(char* filename, double scale);                                                  // use recorded trace instead of FMC FRU Programmer
+BOOL   replay_write(unsigned char* data, int N, int* write_N);                                     // compare bytes sent by host with trace
+BOOL   replay_read(unsigned char* data, int N, DWORD* read_N);                                     // bytes received in trace, with recorded timing
+void   replay_wait(double t);                                                                      // wait until time stamp t
+
 int getopt(int nargc, char * const nargv[], const char *ostr);                                     // windows clone getopt from unistd.h
 
 int verbose_on;                                                                                    // enable/disable printf stdout
+unsigned char device_read_burst;                                                                   // read burst length currently configured on FMC FRU Programmer
+unsigned int  fw_version;                                                                          // firmware version of FMC FRU Programmer, see FW_VERSION()
+char*         port_name;                                                                           // serial port selected with -c, NULL: scan COM ports
+bench_log*    bench;                                                                               // command latencies of running benchmark, NULL: no benchmark
+host_stats*   stats;                                                                               // statistics of serial port traffic, NULL: -S not set
+trace_log*    trace;                                                                               // recording of serial port traffic, NULL: -t not set
+replay_log*   replay;                                                                              // recorded traffic replaces FMC FRU Programmer, NULL: -y not set
 int opterr;		                                                                                    // if error message should be printed
 int optind;		                                                                                    // index into parent argv vector
 int optopt;		                                                                                    // character checked for validity
@@ -70,18 +291,35 @@ void usage(void)
           " as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.\n\n\n");
    printf(" File transfer (EEPROM binary images)\n"
           "    -d <filename.bin>\tdownload content from FMC FRU EEPROM and write to file)\n"
-          "    -u <filename.bin>\tupload a file to FMC FRU EEPROM)\n\n");
+          "    -u <filename.bin>\tupload a file to FMC FRU EEPROM)\n"
+          "    -U <filename.bin>\tupload a file to FMC FRU EEPROM, only pages that differ from EEPROM content are written\n"
+          "    -x <filename.bin>\tprint write plan for a file, nothing is written\n"
+          "    -B <report.csv>\tbenchmark download, upload and verify with all read and write methods,\n"
+          "                   \tthe EEPROM content is restored afterwards (report.json for JSON output)\n\n");
    printf(" EEPROM read/write parameters\n"
           "    -a <1,2> set address width in bytes (1 or 2 bytes are supported)\n"
           "    -l <1024 .. 524288> set EEPROM size in bits (multiples of 1024 allowed)\n"
           "    -L  <128 ..  65536> set EEPROM size in Bytes (multiples of 128 allowed)\n"
           "    -r  <1, 8, 16, 24, .. 64> set read burst size in bytes (8 byte is default)\n"
-          "    -w  <1, 8, 16, 32>        set write burst size in bytes (8 byte is default)\n\n");
+          "    -w  <1, 8, 16, 32>        set write burst size in bytes (EEPROM page size is default)\n"
+          "    -P  <8, 16, 32, 64, 128>  set EEPROM page size in bytes (derived from EEPROM size by default)\n"
+          "    -q  <1 .. 32>             set number of read commands in flight during download (4 is default)\n"
+          "    -k  <kHz, auto>           set I2C clock (100 kHz after power up), auto: fastest clock with a clean readback\n\n");
    printf(" Miscellaneous functions\n"          
           "    -i\t\t\tScan I2C bus for EEPROM devices\n"
           "    -m\t\t\tMemory autodetect\n"
           "    -p\t\t\tScan Present pin of FMC module\n"
-          "    -s\t\t\tScan serial ports for FMC FRU Programmer\n\n");
+          "    -s\t\t\tScan serial ports for FMC FRU Programmer\n"
+          "    -T\t\t\tPrint and reset time per command phase measured by the FMC FRU Programmer,\n"
+          "      \t\t\tuse it before and after a transfer (e.g. -T -d dump.bin -T)\n"
+          "    -c <port>\t\tUse this serial port instead of a scan (e.g. COM7, /dev/ttyACM0, pty of the simulator),\n"
+          "             \t\tmust precede all other options\n"
+          "    -S <stats.json>\tWrite latency histograms per command and time per phase (port discovery, I2C scan,\n"
+          "                   \tautodetect, transfer) to a JSON file, must precede all other options\n"
+          "    -t <trace.bin>\tRecord all bytes sent to and received from FMC FRU Programmer with time stamps,\n"
+          "                 \tmust precede all other options\n"
+          "    -y <trace.bin[,scale]>\tReplay a recorded trace instead of FMC FRU Programmer, recorded delays are\n"
+          "                        \tmultiplied by scale (1 is default, 0: no delays), use the options of the recording\n\n");
 }
 
 int main(int argc, char **argv)
@@ -92,10 +330,14 @@ int main(int argc, char **argv)
    unsigned int  N_bytes;        // number of bytes to read from EEPROM
    unsigned char read_burst;     // number of bytes transferred during a read cycle
    unsigned char write_burst;    // number of bytes transferred during a write cycle
+   int  read_depth;              // number of read commands in flight during download
+   unsigned int  page_size;      // EEPROM page size in bytes, writes never cross a page boundary
    char opt;                     // helper for parsing argument strings
    int opt_num;                  // helper for parsing numerical strings
    char *input_file = NULL;      // string ptr for input filename
    char *output_file = NULL;     // string ptr for output filename
+   char *p;                      // helper for parsing argument strings
+   double scale;                 // timing factor of replay
    HANDLE hComm;                 // Serial port handle
 
    opterr = 1;
@@ -105,12 +347,54 @@ int main(int argc, char **argv)
    N_addr      = 0x00;
    N_bytes     = 0x00000000;
    read_burst  = 0x08;
-   write_burst = 0x08;
+   write_burst = 0x00;           // 0: page size
+   read_depth  = READ_DEPTH_DEFAULT;
+   page_size   = 0;              // 0: derived from EEPROM size
 
-   while ((opt = getopt (argc, argv, "a:l:L:r:w:d:u:imps?h")) != -1)
+   while ((opt = getopt (argc, argv, "c:S:t:y:a:l:L:r:w:q:P:k:d:u:U:x:B:impsT?h")) != -1)
    {    
       switch (opt)
       {
+         case 'c':
+            port_name = optarg;
+
+            printf("\nSet serial port: %s\n",port_name);
+
+            break;
+
+         case 'S':
+            stats = (host_stats*)calloc(1, sizeof(host_stats));
+            if (stats == NULL)
+               break;
+            stats->filename = optarg;
+            stats->t_phase  = time_us();
+            stats->last     = STATS_DATA;
+
+            printf("\nWrite statistics to: %s\n",optarg);
+
+            break;
+
+         case 't':
+            if (trace_open(optarg))
+               printf("\nRecord serial port traffic to: %s\n",optarg);
+            else
+               printf("\nCannot open file %s\n",optarg);
+            break;
+
+         case 'y':
+            scale = 1.0;                                          // original timing by default
+            p     = strrchr(optarg, ',');
+            if (p)
+            {
+               *p    = 0;
+               scale = atof(p+1);
+            }
+            if (replay_load(optarg, scale))
+               printf("\nReplay serial port traffic from: %s (timing x %.2f)\n",optarg,scale);
+            else
+               return 1;
+            break;
+
          case 'a':
             opt_num = atoi(optarg);
             if (opt_num == 1)
@@ -169,7 +453,7 @@ int main(int argc, char **argv)
                break;
             }
 
-            CloseHandle(hComm); // close serial port handle, not needed anymore
+            port_close(&hComm); // close serial port handle, not needed anymore
             break;
 
          case 'w':
@@ -177,12 +461,58 @@ int main(int argc, char **argv)
             if ((opt_num==1) || (opt_num==8) || (opt_num==16) || (opt_num==32)) // 1, 8, 16, 32
                write_burst = opt_num;
             else
-               write_burst = 0x08;
+               write_burst = 0x00;
 
             printf("\nSet write burst length: %d\n",write_burst);
 
             break;              
 
+         case 'P':
+            opt_num = atoi(optarg);
+            if ((opt_num==8) || (opt_num==16) || (opt_num==32) || (opt_num==64) || (opt_num==128))
+               page_size = opt_num;
+            else
+               page_size = 0;
+
+            printf("\nSet EEPROM page size: %d bytes\n",page_size);
+
+            break;
+
+         case 'q':
+            opt_num = atoi(optarg);
+            if ((opt_num >= 1) && (opt_num <= READ_DEPTH_MAX))
+               read_depth = opt_num;
+            else
+               read_depth = READ_DEPTH_DEFAULT;
+
+            printf("\nSet read commands in flight: %d\n",read_depth);
+
+            break;
+
+         case 'k':
+            verbose_on = 0;               // hide outputs from s_task and i_task
+            ret      = s_task(&hComm);    // run serial port scan
+            if (ret)
+               i2c_addr = i_task(&hComm); // run i2c scan
+            else
+            {
+               printf("\nNo FMC FRU Programmer connected!\n");
+               break;
+            }
+
+            if (i2c_addr!=0xFF)           // valid EEPROM i2c address found
+            {
+               verbose_on = 1;            // show outputs from k_task
+               if (!k_task(&hComm, i2c_addr, &N_addr, N_bytes, optarg))
+                  printf("\nCould not set I2C clock!\n");
+               verbose_on = 0;            // disable show outputs
+            }
+            else
+               printf("\nNo I2C EEPROM found!\n");
+
+            port_close(&hComm);           // close serial port handle, not needed anymore
+            break;
+
          case 'd':
             verbose_on = 0;               // hide outputs from s_task and i_task
             ret      = s_task(&hComm);    // run serial port scan
@@ -197,13 +527,13 @@ int main(int argc, char **argv)
             if (i2c_addr!=0xFF)           // valid EEPROM i2c address found
             {
                verbose_on = 1;            // show outputs from d_task  
-               d_task(&hComm, i2c_addr, &N_addr, &N_bytes, read_burst, optarg);
+               d_task(&hComm, i2c_addr, &N_addr, &N_bytes, read_burst, read_depth, optarg);
                verbose_on = 0;            // disable show outputs
             }                  
             else
                printf("\nNo I2C EEPROM found!\n");
 
-            CloseHandle(hComm);           // close serial port handle, not needed anymore                  
+            port_close(&hComm);           // close serial port handle, not needed anymore                  
             break;
 
          case 'u':
@@ -220,15 +550,61 @@ int main(int argc, char **argv)
             if (i2c_addr!=0xFF)           // valid EEPROM i2c address found
             {
                verbose_on = 1;            // show outputs from u_task  
-               u_task(&hComm, i2c_addr, &N_addr, &N_bytes, write_burst, optarg);
+               u_task(&hComm, i2c_addr, &N_addr, &N_bytes, write_burst, page_size, optarg);
                verbose_on = 0;            // disable show outputs
             }                  
             else
                printf("\nNo I2C EEPROM found!\n");
 
-            CloseHandle(hComm);           // close serial port handle, not needed anymore                  
+            port_close(&hComm);           // close serial port handle, not needed anymore                  
             break; 
 
+         case 'U':
+            verbose_on = 0;               // hide outputs from s_task and i_task
+            ret      = s_task(&hComm);    // run serial port scan
+            if (ret)
+               i2c_addr = i_task(&hComm); // run i2c scan
+            else
+            {
+               printf("\nNo FMC FRU Programmer connected!\n");           
+               break;
+            }
+
+            if (i2c_addr!=0xFF)           // valid EEPROM i2c address found
+            {
+               verbose_on = 1;            // show outputs from U_task  
+               U_task(&hComm, i2c_addr, &N_addr, &N_bytes, write_burst, page_size, read_burst, read_depth, optarg);
+               verbose_on = 0;            // disable show outputs
+            }                  
+            else
+               printf("\nNo I2C EEPROM found!\n");
+
+            port_close(&hComm);           // close serial port handle, not needed anymore                  
+            break; 
+
+         case 'x':
+            x_task(N_bytes, write_burst, page_size, optarg); // no FMC FRU Programmer needed
+            break;
+
+         case 'B':
+            verbose_on = 0;               // hide outputs from s_task and i_task
+            ret      = s_task(&hComm);    // run serial port scan
+            if (ret)
+               i2c_addr = i_task(&hComm); // run i2c scan
+            else
+            {
+               printf("\nNo FMC FRU Programmer connected!\n");
+               break;
+            }
+
+            if (i2c_addr!=0xFF)           // valid EEPROM i2c address found
+               B_task(&hComm, i2c_addr, &N_addr, &N_bytes, page_size, read_depth, optarg);
+            else
+               printf("\nNo I2C EEPROM found!\n");
+
+            port_close(&hComm);           // close serial port handle, not needed anymore
+            break;
+
          case 'i':
             verbose_on = 0;               // hide outputs from s_task
             ret = s_task(&hComm);         // run serial port scan
@@ -241,7 +617,7 @@ int main(int argc, char **argv)
                printf("\nNo FMC FRU Programmer connected!\n");           
                break;
             }
-            CloseHandle(hComm);           // close serial port handle, not needed anymore            
+            port_close(&hComm);           // close serial port handle, not needed anymore            
             break;  
 
          case 'm':
@@ -272,7 +648,7 @@ int main(int argc, char **argv)
             }
             else
                printf("\nNo I2C EEPROM found!\n");
-            CloseHandle(hComm);   // close serial port handle, not needed anymore             
+            port_close(&hComm);   // close serial port handle, not needed anymore             
             break;
 
          case 'p':
@@ -291,26 +667,50 @@ int main(int argc, char **argv)
                printf("\nNo FMC FRU Programmer connected!\n");           
                break;
             }
-            CloseHandle(hComm);   // close serial port handle, not needed anymore            
+            port_close(&hComm);   // close serial port handle, not needed anymore            
             break;
 
          case 's':
             verbose_on = 1;
             s_task(&hComm);       // run a serial port scan
-            CloseHandle(hComm);   // close serial port handle, not needed anymore
+            port_close(&hComm);   // close serial port handle, not needed anymore
+            break;
+
+         case 'T':
+            verbose_on = 0;       // hide outputs from s_task
+            ret = s_task(&hComm); // run serial port scan
+            verbose_on = 1;       // show outputs from T_task
+            if (ret)
+               T_task(&hComm);    // print and reset profiling counters
+            else
+            {
+               printf("\nNo FMC FRU Programmer connected!\n");
+               break;
+            }
+            port_close(&hComm);   // close serial port handle, not needed anymore
             break;
          case '?':            
          case 'h':            
             usage();
             switch (optopt)
             {
+               case 'c': printf("\n\nExample usage:\nfmc_fru_programmer.exe -c COM7 -d eeprom_dump.bin\n"); break;
+               case 'S': printf("\n\nExample usage:\nfmc_fru_programmer.exe -S stats.json -d eeprom_dump.bin\n"); break;
+               case 't': printf("\n\nExample usage:\nfmc_fru_programmer.exe -t session.trace -U file_to_upload.bin\n"); break;
+               case 'y': printf("\n\nExample usage:\nfmc_fru_programmer.exe -y session.trace,0 -U file_to_upload.bin\n"); break;
                case 'a': printf("\n\nExample usage:\nfmc_fru_programmer.exe -a 1\n"); break;
                case 'l': printf("\n\nExample usage:\nfmc_fru_programmer.exe -l 2048\n"); break;
                case 'L': printf("\n\nExample usage:\nfmc_fru_programmer.exe -L 256\n"); break;
                case 'r': printf("\n\nExample usage:\nfmc_fru_programmer.exe -r 8\n"); break;
                case 'w': printf("\n\nExample usage:\nfmc_fru_programmer.exe -w 8\n"); break;
+               case 'q': printf("\n\nExample usage:\nfmc_fru_programmer.exe -q 8 -d eeprom_dump.bin\n"); break;
+               case 'k': printf("\n\nExample usage:\nfmc_fru_programmer.exe -k auto -d eeprom_dump.bin\n"); break;
                case 'd': printf("\n\nExample usage:\nfmc_fru_programmer.exe -d file_to_upload.bin\n"); break;
                case 'u': printf("\n\nExample usage:\nfmc_fru_programmer.exe -u filename_for_download.bin\n"); break;
+               case 'U': printf("\n\nExample usage:\nfmc_fru_programmer.exe -U file_to_upload.bin\n"); break;
+               case 'P': printf("\n\nExample usage:\nfmc_fru_programmer.exe -P 32 -u file_to_upload.bin\n"); break;
+               case 'x': printf("\n\nExample usage:\nfmc_fru_programmer.exe -L 4096 -x file_to_upload.bin\n"); break;
+               case 'B': printf("\n\nExample usage:\nfmc_fru_programmer.exe -a 2 -L 4096 -B benchmark.csv\n"); break;
             }
             return 1;
             break;
@@ -324,6 +724,10 @@ int main(int argc, char **argv)
    if (argc==1)
       usage();
 
+   if (stats)
+      stats_report();
+   if (trace)
+      fclose(trace->fp);
    return 0;
 }
 
@@ -331,13 +735,15 @@ int main(int argc, char **argv)
  * -d option
  * Download content from EEPROM
  */
-int d_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char read_burst, char* filename)
+int d_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char read_burst, int read_depth, char* filename)
 {  
-   unsigned char rxbuffer[RX_BUFFER_SIZE]; // buffer for readout
-   int           read_N;                   // number of bytes in readout buffer
+   unsigned char* image;                   // buffer for EEPROM content
+   unsigned int   N_read;                  // number of bytes read from EEPROM
 
    FILE*         fp;                       // file pointer to outpput file  
 
+   stats_phase(PHASE_TRANSFER);
+
    if (*N_addr==0x00) // addressin width is not valid
    {
       *N_addr = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
@@ -357,208 +763,573 @@ int d_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigne
          printf("\nNumber of bytes not set, using default value: %d\n",*N_bytes);
    }
 
-   printf("\nDownloading %d bytes (burst length: %d) to file %s\n",*N_bytes, read_burst, filename);
+   if (device_read_burst != read_burst)  // replies are read with exact length, programmer must use the same burst length
+   {
+      if (!r_task(hComm, read_burst))
+      {
+         printf("\nCould not set read burst length!\n");
+         return 0;
+      }
+   }
+
+   if ((*N_addr != 1) && (*N_addr != 2))
+   {
+      printf("\nError during readout, address width (%d) is not valid\n",*N_addr);
+      return 0;
+   }
+
+   if (fw_version < FW_PIPELINE)  // older firmware discards queued commands
+      read_depth = 1;
+
+   printf("\nDownloading %d bytes (burst length: %d, commands in flight: %d) to file %s\n",*N_bytes, read_burst, read_depth, filename);
+
+   image = (unsigned char*)malloc(*N_bytes + read_burst);  // last burst may exceed N_bytes
+   if (image == NULL)
+   {
+      printf("\nCannot allocate %d bytes for readout\n",*N_bytes);
+      return 0;
+   }
+
+   N_read = read_image(hComm, i2c_addr, *N_addr, *N_bytes, read_burst, read_depth, image);
 
    fp = fopen(filename, "wb");
-   for(unsigned int addr=0; addr < *N_bytes; addr=addr+read_burst)//addr++)
-   {       
-
-     if (*N_addr == 2)
-        Read_from_eeprom(i2c_addr, addr, rxbuffer, &read_N, hComm);             // 2 byte addressing Read command
-     else if (*N_addr == 1)
-        read_from_eeprom(i2c_addr, addr, rxbuffer, &read_N, hComm);             // 2 byte addressing Read command
-     else
-     {        
-        printf("\nError during readout, address width (%d) is not valid\n",*N_addr);
-        break;
-     }
-
-     if (readOk(rxbuffer, read_N))   // check return values for ACK
-     {
-         fwrite(rxbuffer+1,1,read_burst,fp); // write bytes in file, skip first position (its the ACK)
-         fflush(fp);
-         printf("%3.1f%%\r", (float)(addr+read_burst) / (float)(*N_bytes) * 100.0);
-         fflush(stdout);
-     }     
-     else
-     {        
-        printf("\nError during readout, EEPROM returns no ACK on Read command!\n");
-        break;
-     }        
+   if (fp == NULL)
+   {
+      printf("\nCannot open file %s\n",filename);
+      free(image);
+      return 0;
    }
+   fwrite(image,1,N_read,fp);
    fclose(fp);
-   return 1;
+   free(image);
+   return (N_read == *N_bytes);
 }
 
 /*
  * -u option
  * Upload content from EEPROM
  */
-int u_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char write_burst, char* filename)
+int u_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char write_burst, unsigned int page_size, char* filename)
 {
-   unsigned char readchar;                    // read one byte from file
-   unsigned char writebuffer[TX_BUFFER_SIZE]; // writebuffer for EEPROM   
-   char rxbuffer[RX_BUFFER_SIZE];             // receive buffer for ACK
-   int read_N;                                // received bytes
-   int c;
-   int i;
-   
-   unsigned int mem_addr;                     // mem addr counter for EEPROM content
-   FILE* fp;                                  // file pointer to outpput file  
-   unsigned int filesize;                     // filesize in bytes
-   unsigned int cnt_download;                 // byte counter for download
+   unsigned char* image;                      // file content
+   unsigned int   filesize;                   // filesize in bytes
+   write_op*      plan;                       // write commands for file content
+   int            N_ops;                      // number of write commands in plan
+   int            N_written;                  // number of write commands executed successfully
    float n_log2;
-   fp = fopen(filename, "rb");
-   if (fp == NULL)
+
+   stats_phase(PHASE_TRANSFER);
+   image = load_image(filename, &filesize);
+   if (image == NULL)
+      return 0;
+
+   if (*N_bytes==0x00000000)                  // EEPROM size not set, use next power of 2
    {
-      fclose(fp);
-      printf("\nCannot open file %s\n",filename);
+      n_log2   = log((double)filesize) / log(2.0);
+      *N_bytes = (unsigned int)pow(2,ceil(n_log2));
+   }
+   if (filesize > *N_bytes)
+   {
+      printf("\nFile %s (%d bytes) does not fit into EEPROM (%d bytes)\n",filename,filesize,*N_bytes);
+      free(image);
       return 0;
    }
-   else
+
+   if (*N_addr==0x00) // addressin width is not valid
    {
-      fseek(fp, 0, SEEK_END); // seek to end of file
-      filesize = ftell(fp);   // get filesize
-      fseek(fp, 0, SEEK_SET); // seek back to beginning of file    
+      *N_addr = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
+      if (verbose_on)
+         printf("\nAddress width not set, using value %d (determined by I2C addr:0x%02X)\n",*N_addr,i2c_addr);
+   }
 
-      i        = 1;
-      mem_addr = 0;
-      n_log2   = log((double)filesize) / log(2.0);
-      *N_bytes = (unsigned int)pow(2,ceil(n_log2));                // set N_bytes to next power of 2
+   if (page_size == 0)                        // page size not set, use smallest page size of this EEPROM size
+      page_size = default_page_size(*N_bytes);
 
-      if (*N_addr==0x00) // addressin width is not valid
-      {
-         *N_addr = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
-         if (verbose_on)
-            printf("\nAddress width not set, using value %d (determined by I2C addr:0x%02X)\n",*N_addr,i2c_addr);
-      }
+   plan  = (write_op*)malloc(sizeof(write_op) * filesize);
+   if (plan == NULL)
+   {
+      free(image);
+      return 0;
+   }
+   N_ops = plan_writes(filesize, page_size, write_burst, plan, filesize);
 
-      printf("\nUploading file %s (%d bytes)\n",filename,filesize);
-      cnt_download = 0;
-      while(c = fgetc(fp), c != EOF)
-      {
-         readchar     = (unsigned char)c;
-         cnt_download = cnt_download + 1;
-         writebuffer[i-1] = readchar;
-         printf("%3.1f%%\r", (float)(cnt_download) / (float)(filesize) * 100.0);
-         fflush(stdout);
-         //printf("0x%02X ",writebuffer[i-1]);  fflush(stdout);      
-         if ((i % write_burst)==0)
-         {            
-            //printf(" (Addr: 0x%04X)\n",mem_addr-write_burst+1);  fflush(stdout);        
-            i = 1;
-            if (*N_addr == 2)
-            {
-               Write_to_eeprom_burst(i2c_addr, mem_addr-write_burst+1, writebuffer, write_burst, rxbuffer, &read_N, hComm); // bust write with 2 byte addressing
-            }
-            else if (*N_addr == 1)
-               write_to_eeprom_burst(i2c_addr, mem_addr-write_burst+1, writebuffer, write_burst, rxbuffer, &read_N, hComm); // bust write with 1 byte addressing
-            else
-            {        
-               printf("\nError during readout, address width (%d) is not valid\n",*N_addr);
-               break;
-            }            
-         }
-         else
-         {
-            if (mem_addr >= (filesize - (filesize % write_burst))) // too few remaining bytes for burst write
-            {
-               if (*N_addr == 2)
-               {
-                  Write_to_eeprom(i2c_addr, mem_addr, readchar, rxbuffer, &read_N, hComm); // bust write with 2 byte addressing
-               }
-               else if (*N_addr == 1)
-                  write_to_eeprom(i2c_addr, mem_addr, readchar, rxbuffer, &read_N, hComm); // bust write with 1 byte addressing
-               else
-               {        
-                  printf("\nError during readout, address width (%d) is not valid\n",*N_addr);
-                  break;
-               }
-               //printf("mem_addr: 0x%02X (char: 0x%02X)\n",mem_addr, readchar);
-               fflush(stdout);
-            }
-            i = i + 1;
-         }
-         if (ferror(fp))
-         {
-            /* error handling here */
-             printf("\nError while reading file %s\n",filename);
-         }
-         mem_addr = mem_addr + 1;
-      }
-      
-      fclose(fp);
-      return 1;
-   }   
+   printf("\nUploading file %s (%d bytes, page size: %d, write commands: %d)\n",filename,filesize,page_size,N_ops);
+
+   N_written = write_image(hComm, i2c_addr, *N_addr, image, plan, N_ops, write_burst_length(page_size, write_burst));
+
+   free(plan);
+   free(image);
+
+   if (N_written != N_ops)
+      return 0;
+
+   if (verbose_on && (fw_version >= FW_ACKPOLL))
+      printf("\nEEPROM write cycle time: %d us\n",write_cycle_time(hComm));
+   return 1;
 }
 
 /*
- * -m option
- * I2C Memory Autodetect, see AN690 from Microchip for details
- * this function determines addressing scheme and memory size of FMC FRU EEPROM
+ * -U option
+ * Differential upload, the EEPROM content is read first and only write commands with changed data are executed
  */
-int m_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes)
+int U_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned char write_burst, unsigned int page_size,
+           unsigned char read_burst, int read_depth, char* filename)
 {
-   int ret = 0;                        // default return value
-   int state = 1;                      // states of algorithm
-   int debug = 0;                      // output debug information   
-   char rxbuffer[RX_BUFFER_SIZE];      // receive buffer
-   int  read_N;                        // number of valid bytes in rx buffer
-
-   unsigned char read_value_1byteaddr_x00; // read value from addr 0x00 with 1 byte addressing
-   unsigned char read_value_1byteaddr_x01; // read value from addr 0x01 with 1 byte addressing
-   unsigned char read_value_2byteaddr;     // read value from addr 0x00 with 2 byte addressing
-
-   int MODEL;                          // used to determine EEPROM Model 24Cxx
-   int L;                              // used to determine Length of EEPROM in Bytes
+   unsigned char* image;                      // file content
+   unsigned char* eeprom;                     // current EEPROM content
+   unsigned int   filesize;                   // filesize in bytes
+   unsigned int   N_read;                     // number of bytes read from EEPROM
+   write_op*      plan;                       // write commands for file content
+   int            N_ops;                      // number of write commands in plan
+   int            N_diff;                     // number of write commands with changed data
+   int            N_pages;                    // number of EEPROM pages covered by file
+   int            N_written;                  // number of write commands executed successfully
+   float n_log2;
 
-   unsigned char N_addr_default;
-   N_addr_default = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
+   stats_phase(PHASE_TRANSFER);
+   image = load_image(filename, &filesize);
+   if (image == NULL)
+      return 0;
 
-   if (state == 1)
+   if (*N_bytes==0x00000000)                  // EEPROM size not set, use next power of 2
    {
-      // (1.A) READ FROM ADDR 0x00 WITH 1 BYTE ADDRESSING
-      read_from_eeprom(i2c_addr, 0x00, rxbuffer, &read_N, hComm);             // must return 0x06 (0x06 is ACK) in rxbuffer[0]
-      if (readOk(rxbuffer, read_N))                                          // check return values for ACK
-      {
-         read_value_1byteaddr_x00 = rxbuffer[1];
-         state = 2;                                // goto next state
-         if (debug)
-            printf("read: 0x%02X\n", read_value_1byteaddr_x00);
-      }
-      // (1.B) READ FROM ADDR 0x01 WITH 1 BYTE ADDRESSING
-      read_from_eeprom(i2c_addr, 0x01, rxbuffer, &read_N, hComm);             // must return 0x06 (0x06 is ACK) in rxbuffer[0]
-      if (readOk(rxbuffer, read_N))                                          // check return values for ACK
-      {
-         read_value_1byteaddr_x01 = rxbuffer[1];
-         state = 2;                                // goto next state
-         if (debug)
-            printf("read: 0x%02X\n", read_value_1byteaddr_x01);
-      }
+      n_log2   = log((double)filesize) / log(2.0);
+      *N_bytes = (unsigned int)pow(2,ceil(n_log2));
+   }
+   if (filesize > *N_bytes)
+   {
+      printf("\nFile %s (%d bytes) does not fit into EEPROM (%d bytes)\n",filename,filesize,*N_bytes);
+      free(image);
+      return 0;
    }
 
-   if (state == 2)
+   if (*N_addr==0x00) // addressin width is not valid
    {
-      // (2) READ FROM ADDR 0x0000 WITH 2 BYTE ADDRESSING
-      Read_from_eeprom(i2c_addr, (unsigned int)0x0000, rxbuffer, &read_N, hComm); // must return 0x06 (0x06 is ACK) in rxbuffer[0]
-      if (readOk(rxbuffer, read_N))                                              // check return values for ACK
-      {
-         read_value_2byteaddr = rxbuffer[1];
-         state = 3;                                // goto next state
-         if (debug)
-            printf("Read: 0x%02X\n", read_value_2byteaddr);
-      }
+      *N_addr = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
+      if (verbose_on)
+         printf("\nAddress width not set, using value %d (determined by I2C addr:0x%02X)\n",*N_addr,i2c_addr);
+   }
+   if ((*N_addr != 1) && (*N_addr != 2))
+   {
+      printf("\nError during upload, address width (%d) is not valid\n",*N_addr);
+      free(image);
+      return 0;
    }
 
-   if (state == 3)
+   if (page_size == 0)                        // page size not set, use smallest page size of this EEPROM size
+      page_size = default_page_size(*N_bytes);
+
+   if (device_read_burst != read_burst)       // replies are read with exact length, programmer must use the same burst length
    {
-      // (3) WRITE VALUE 0x01 TO ADDR 0x0000 WITH 2 BYTE ADDRESSING
-      Write_to_eeprom(i2c_addr, (unsigned int)0x0000, 0x01, rxbuffer, &read_N, hComm); // must return 0x06 (0x06 is ACK) in rxbuffer[0]
-      if (writeOk(rxbuffer, read_N))                                                   // check return values for ACK
+      if (!r_task(hComm, read_burst))
       {
-         state = 4;                                // goto next state
-         if (debug)
-            printf("Write ok (ACK: 0x%02X)\n",rxbuffer[0]);
+         printf("\nCould not set read burst length!\n");
+         free(image);
+         return 0;
+      }
+   }
+   if (fw_version < FW_PIPELINE)              // older firmware discards queued commands
+      read_depth = 1;
+
+   eeprom = (unsigned char*)malloc(filesize + read_burst);  // last burst may exceed filesize
+   plan   = (write_op*)malloc(sizeof(write_op) * filesize);
+   if ((eeprom == NULL) || (plan == NULL))
+   {
+      free(eeprom);
+      free(plan);
+      free(image);
+      return 0;
+   }
+
+   printf("\nReading %d bytes of EEPROM content\n",filesize);
+   N_read = read_image(hComm, i2c_addr, *N_addr, filesize, read_burst, read_depth, eeprom);
+   if (N_read != filesize)
+   {
+      free(eeprom);
+      free(plan);
+      free(image);
+      return 0;
+   }
+
+   N_ops   = plan_writes(filesize, page_size, write_burst, plan, filesize);
+   N_pages = count_pages(plan, N_ops, page_size);
+   N_diff  = diff_plan(image, eeprom, plan, N_ops);
+
+   printf("\nUploading file %s (%d bytes, page size: %d), %d of %d pages unchanged and skipped\n",
+          filename,filesize,page_size,N_pages-count_pages(plan, N_diff, page_size),N_pages);
+
+   N_written = write_image(hComm, i2c_addr, *N_addr, image, plan, N_diff, write_burst_length(page_size, write_burst));
+
+   free(eeprom);
+   free(plan);
+   free(image);
+
+   if (N_written != N_diff)
+      return 0;
+
+   if (verbose_on && (fw_version >= FW_ACKPOLL) && (N_diff > 0))
+      printf("\nEEPROM write cycle time: %d us\n",write_cycle_time(hComm));
+   return 1;
+}
+
+/*
+ * -x option
+ * Print the write plan for a file, no FMC FRU Programmer is needed
+ */
+int x_task(unsigned int N_bytes, unsigned char write_burst, unsigned int page_size, char* filename)
+{
+   unsigned char* image;                      // file content
+   unsigned int   filesize;                   // filesize in bytes
+   write_op*      plan;                       // write commands for file content
+   int            N_ops;                      // number of write commands in plan
+   int            N_legacy;                   // number of write commands with fixed bursts and single byte tail
+   unsigned char  burst;                      // write burst length used for comparison
+
+   image = load_image(filename, &filesize);
+   if (image == NULL)
+      return 0;
+   free(image);
+
+   if (N_bytes == 0)
+      N_bytes = filesize;
+   if (page_size == 0)
+      page_size = default_page_size(N_bytes);
+
+   plan  = (write_op*)malloc(sizeof(write_op) * filesize);
+   if (plan == NULL)
+      return 0;
+   N_ops = plan_writes(filesize, page_size, write_burst, plan, filesize);
+
+   burst    = (write_burst != 0) ? write_burst : 8;
+   N_legacy = filesize / burst + filesize % burst;
+
+   printf("\nWrite plan for file %s (%d bytes, page size: %d)\n",filename,filesize,page_size);
+   for (int i=0; i<N_ops; i++)
+      printf("   %4d: addr 0x%04X, %3d bytes\n",i,plan[i].addr,plan[i].N);
+   printf("\n   write commands: %d (fixed %d byte bursts: %d)\n",N_ops,burst,N_legacy);
+
+   free(plan);
+   return N_ops;
+}
+
+/*
+ * -B option
+ * Benchmark of download, upload and verify cycles on transfer sizes from 256 bytes up to the EEPROM size
+ * Downloads run r/R commands with every read burst length plus d/D range reads and frames if supported,
+ * uploads run w/W commands with every write burst length up to the page size plus u/U streaming writes,
+ * every upload writes a new pattern and is verified with the default read method
+ * The EEPROM content is restored afterwards
+ */
+int B_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes, unsigned int page_size, int read_depth, char* filename)
+{
+   static const unsigned char read_bursts[]  = { 1, 8, 16, 24, 32, 40, 48, 56, 64 };
+   static const unsigned char write_bursts[] = { 1, 8, 16, 32 };
+   static bench_result results[BENCH_RESULTS_MAX]; // one result per benchmark run
+   bench_log      log;                        // command latencies of current run
+   unsigned char* backup;                     // EEPROM content before benchmark
+   unsigned char* image;                      // expected EEPROM content, test patterns are written into it
+   unsigned char* readback;                   // EEPROM content read during benchmark
+   write_op*      plan;                       // write commands for test pattern
+   unsigned char  read_burst;                 // read burst length of FMC FRU Programmer before benchmark
+   unsigned char  burst;                      // burst length of current run
+   unsigned int   size;                       // transfer size of current run
+   unsigned int   N;                          // bytes read or written
+   int            N_ops;                      // number of write commands in plan
+   int            N_results = 0;              // number of benchmark runs
+   int            restored;                   // EEPROM content was restored
+   double         t_start;                    // begin of current run
+   bench_result*  r;
+
+   stats_phase(PHASE_TRANSFER);
+   if (*N_addr==0x00) // addressin width is not valid
+      *N_addr = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
+   if (*N_bytes==0x00000000)
+      *N_bytes = (*N_addr==1) ? 256 : 4096;   // recommendation 5.7-2 in ANSI VITA 57.1
+   if (page_size == 0)
+      page_size = default_page_size(*N_bytes);
+   if (fw_version < FW_PIPELINE)              // older firmware discards queued commands
+      read_depth = 1;
+   read_burst = device_read_burst;
+
+   backup      = (unsigned char*)malloc(*N_bytes + 64);
+   image       = (unsigned char*)malloc(*N_bytes + 64);
+   readback    = (unsigned char*)malloc(*N_bytes + 64);
+   plan        = (write_op*)malloc(sizeof(write_op) * *N_bytes);
+   log.latency = (double*)malloc(sizeof(double) * BENCH_LATENCY_MAX);
+   if ((backup == NULL) || (image == NULL) || (readback == NULL) || (plan == NULL) || (log.latency == NULL))
+   {
+      printf("\nCannot allocate %d bytes for benchmark\n",*N_bytes);
+      free(backup); free(image); free(readback); free(plan); free(log.latency);
+      return 0;
+   }
+
+   printf("\nBenchmark of EEPROM at 0x%02X (%d bytes, %d byte addressing, page size: %d, commands in flight: %d)\n",
+          i2c_addr,*N_bytes,*N_addr,page_size,read_depth);
+   if (read_image(hComm, i2c_addr, *N_addr, *N_bytes, read_burst, read_depth, backup) != *N_bytes)
+   {
+      printf("\nError during benchmark, EEPROM content cannot be saved!\n");
+      free(backup); free(image); free(readback); free(plan); free(log.latency);
+      return 0;
+   }
+   memcpy(image, backup, *N_bytes);
+
+   size = (*N_bytes < BENCH_SIZE_MIN) ? *N_bytes : BENCH_SIZE_MIN;
+   while (N_results + 32 <= BENCH_RESULTS_MAX)
+   {
+      // DOWNLOAD, COMPARED WITH EXPECTED CONTENT
+      for (int m=0; m<(int)sizeof(read_bursts)+2; m++)
+      {
+         r      = &results[N_results];
+         r->op  = "download";
+         burst  = 0;
+         if (m < (int)sizeof(read_bursts))
+         {
+            r->method = "read";
+            burst     = read_bursts[m];
+            if (!r_task(hComm, burst))
+               continue;
+         }
+         else if ((m == (int)sizeof(read_bursts)) && (fw_version >= FW_BULKREAD))
+            r->method = "range";
+         else if ((m == (int)sizeof(read_bursts)+1) && (fw_version >= FW_FRAMES))
+            r->method = "frames";
+         else
+            continue;
+
+         log.N = 0; log.commands = 0;
+         bench   = &log;
+         t_start = time_us();
+         if (burst)
+            N = read_commands(hComm, i2c_addr, *N_addr, size, burst, read_depth, readback);
+         else if (m == (int)sizeof(read_bursts))
+            N = read_range(hComm, i2c_addr, *N_addr, 0x0000, size, readback);
+         else
+            N = read_frames(hComm, i2c_addr, *N_addr, size, read_depth, readback);
+         r->burst = burst;
+         r->bytes = size;
+         r->ok    = (N == size) && (memcmp(readback, image, size) == 0);
+         bench_stats(&log, r, t_start);
+         N_results++;
+      }
+      r_task(hComm, read_burst);
+
+      // UPLOAD OF A NEW PATTERN AND VERIFY
+      for (int m=0; m<(int)sizeof(write_bursts)+1; m++)
+      {
+         r     = &results[N_results];
+         r->op = "upload";
+         if (m < (int)sizeof(write_bursts))
+         {
+            r->method = "write";
+            burst     = write_bursts[m];
+            if (burst > page_size)
+               continue;
+         }
+         else if (fw_version >= FW_STREAMWRITE)
+         {
+            r->method = "stream";
+            burst     = write_burst_length(page_size, STREAM_BURST_MAX);
+         }
+         else
+            continue;
+
+         srand(N_results);
+         for (unsigned int i=0; i<size; i++)
+            image[i] = (unsigned char)rand();
+         N_ops = plan_writes(size, page_size, burst, plan, size);
+
+         log.N = 0; log.commands = 0;
+         bench   = &log;
+         t_start = time_us();
+         if (m < (int)sizeof(write_bursts))
+            N = write_commands(hComm, i2c_addr, *N_addr, image, plan, N_ops);
+         else
+            N = write_streams(hComm, i2c_addr, *N_addr, image, plan, N_ops, burst);
+         r->burst = burst;
+         r->bytes = size;
+         r->ok    = (N == (unsigned int)N_ops);
+         bench_stats(&log, r, t_start);
+         N_results++;
+
+         r         = &results[N_results];
+         r->op     = "verify";
+         r->method = (fw_version >= FW_FRAMES) ? "frames" : (fw_version >= FW_BULKREAD) ? "range" : "read";
+         log.N = 0; log.commands = 0;
+         bench   = &log;
+         t_start = time_us();
+         N = read_image(hComm, i2c_addr, *N_addr, size, read_burst, read_depth, readback);
+         r->burst = (fw_version >= FW_BULKREAD) ? 0 : read_burst;
+         r->bytes = size;
+         r->ok    = (N == size) && (memcmp(readback, image, size) == 0);
+         bench_stats(&log, r, t_start);
+         N_results++;
+      }
+
+      if (size == *N_bytes)
+         break;
+      size = (size * BENCH_SIZE_STEP < *N_bytes) ? size * BENCH_SIZE_STEP : *N_bytes;
+   }
+   bench = NULL;
+
+   for (int i=0; i<N_results; i++)
+      results[i].N_addr = *N_addr, results[i].eeprom_bytes = *N_bytes;
+
+   // RESTORE EEPROM CONTENT
+   N_ops    = plan_writes(*N_bytes, page_size, 0, plan, *N_bytes);
+   restored = (write_image(hComm, i2c_addr, *N_addr, backup, plan, N_ops, write_burst_length(page_size, 0)) == N_ops)
+           && (read_image(hComm, i2c_addr, *N_addr, *N_bytes, read_burst, read_depth, readback) == *N_bytes)
+           && (memcmp(readback, backup, *N_bytes) == 0);
+   if (restored)
+      printf("\nEEPROM content restored\n");
+   else
+      printf("\nError during benchmark, EEPROM content could not be restored!\n");
+
+   free(backup); free(image); free(readback); free(plan); free(log.latency);
+   return bench_report(results, N_results, filename) && restored;
+}
+
+/*
+ * -k option
+ * Set the I2C clock in kHz, the setting is kept by FMC FRU Programmer until the next power up
+ * auto steps the clock up and keeps the fastest clock at which the EEPROM content reads back
+ * identical to a readback at 100 kHz
+ */
+int k_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int N_bytes, char* clock)
+{
+   static const unsigned int steps[] = { 200, 400, 1000 }; // probed clocks in kHz
+   unsigned char* reference;                  // EEPROM content read at default clock
+   unsigned char* probe;                      // EEPROM content read at probed clock
+   unsigned int   N;                          // number of bytes compared
+   unsigned int   khz;                        // clock reached by FMC FRU Programmer
+   unsigned int   best = I2C_CLOCK_DEFAULT;   // fastest clock with clean readback
+
+   stats_phase(PHASE_AUTODETECT);
+   if (fw_version < FW_I2CCLOCK)
+   {
+      printf("\nFirmware of FMC FRU Programmer does not support setting the I2C clock\n");
+      return 0;
+   }
+
+   if (strcmp(clock, "auto") != 0)
+   {
+      khz = set_i2c_clock(hComm, atoi(clock));
+      if (khz)
+         printf("\nSet I2C clock: %d kHz\n",khz);
+      return (khz != 0);
+   }
+
+   if (*N_addr==0x00) // addressin width is not valid
+      *N_addr = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
+
+   N = ((N_bytes != 0) && (N_bytes < PROBE_BYTES)) ? N_bytes : PROBE_BYTES;
+   reference = (unsigned char*)malloc(N + device_read_burst);  // last burst may exceed N
+   probe     = (unsigned char*)malloc(N + device_read_burst);
+   if ((reference == NULL) || (probe == NULL))
+   {
+      free(reference);
+      free(probe);
+      return 0;
+   }
+
+   verbose_on = 0;                            // hide progress of readback
+   if (!set_i2c_clock(hComm, I2C_CLOCK_DEFAULT) ||
+       (read_image(hComm, i2c_addr, *N_addr, N, device_read_burst, READ_DEPTH_DEFAULT, reference) != N))
+   {
+      verbose_on = 1;
+      free(reference);
+      free(probe);
+      return 0;
+   }
+
+   for (int i=0; i<(int)(sizeof(steps)/sizeof(steps[0])); i++)
+   {
+      khz = set_i2c_clock(hComm, steps[i]);
+      if (khz <= best)                        // step is not reachable with the CPU clock of FMC FRU Programmer
+         continue;
+      if ((read_image(hComm, i2c_addr, *N_addr, N, device_read_burst, READ_DEPTH_DEFAULT, probe) != N) ||
+          (memcmp(reference, probe, N) != 0))
+         break;
+      best = khz;
+   }
+   verbose_on = 1;
+
+   free(reference);
+   free(probe);
+
+   khz = set_i2c_clock(hComm, best);
+   if (khz)
+      printf("\nSet I2C clock: %d kHz (fastest clock with clean readback of %d bytes)\n",khz,N);
+   return (khz != 0);
+}
+
+/*
+ * -m option
+ * I2C Memory Autodetect, see AN690 from Microchip for details
+ * this function determines addressing scheme and memory size of FMC FRU EEPROM
+ */
+int m_task(HANDLE* hComm, unsigned char i2c_addr, unsigned char* N_addr, unsigned int* N_bytes)
+{
+   int ret = 0;                        // default return value
+   int state = 1;                      // states of algorithm
+   int debug = 0;                      // output debug information   
+   char rxbuffer[RX_BUFFER_SIZE];      // receive buffer
+   int  read_N;                        // number of valid bytes in rx buffer
+
+   unsigned char read_value_1byteaddr_x00; // read value from addr 0x00 with 1 byte addressing
+   unsigned char read_value_1byteaddr_x01; // read value from addr 0x01 with 1 byte addressing
+   unsigned char read_value_2byteaddr;     // read value from addr 0x00 with 2 byte addressing
+
+   int MODEL;                          // used to determine EEPROM Model 24Cxx
+   int L;                              // used to determine Length of EEPROM in Bytes
+
+   unsigned char N_addr_default;
+   N_addr_default = ((i2c_addr & 0x04) >> 2) + 1; // is 2 when bit 2 from i2c_addr[7..0] is set, is 1 when bit 2 from i2c_addr[7..0] is not set
+   stats_phase(PHASE_AUTODETECT);
+
+   if (state == 1)
+   {
+      // (1.A) READ FROM ADDR 0x00 WITH 1 BYTE ADDRESSING
+      read_from_eeprom(i2c_addr, 0x00, rxbuffer, &read_N, hComm);             // must return 0x06 (0x06 is ACK) in rxbuffer[0]
+      if (readOk(rxbuffer, read_N))                                          // check return values for ACK
+      {
+         read_value_1byteaddr_x00 = rxbuffer[1];
+         state = 2;                                // goto next state
+         if (debug)
+            printf("read: 0x%02X\n", read_value_1byteaddr_x00);
+      }
+      // (1.B) READ FROM ADDR 0x01 WITH 1 BYTE ADDRESSING
+      read_from_eeprom(i2c_addr, 0x01, rxbuffer, &read_N, hComm);             // must return 0x06 (0x06 is ACK) in rxbuffer[0]
+      if (readOk(rxbuffer, read_N))                                          // check return values for ACK
+      {
+         read_value_1byteaddr_x01 = rxbuffer[1];
+         state = 2;                                // goto next state
+         if (debug)
+            printf("read: 0x%02X\n", read_value_1byteaddr_x01);
+      }
+   }
+
+   if (state == 2)
+   {
+      // (2) READ FROM ADDR 0x0000 WITH 2 BYTE ADDRESSING
+      Read_from_eeprom(i2c_addr, (unsigned int)0x0000, rxbuffer, &read_N, hComm); // must return 0x06 (0x06 is ACK) in rxbuffer[0]
+      if (readOk(rxbuffer, read_N))                                              // check return values for ACK
+      {
+         read_value_2byteaddr = rxbuffer[1];
+         state = 3;                                // goto next state
+         if (debug)
+            printf("Read: 0x%02X\n", read_value_2byteaddr);
+      }
+   }
+
+   if (state == 3)
+   {
+      // (3) WRITE VALUE 0x01 TO ADDR 0x0000 WITH 2 BYTE ADDRESSING
+      Write_to_eeprom(i2c_addr, (unsigned int)0x0000, 0x01, rxbuffer, &read_N, hComm); // must return 0x06 (0x06 is ACK) in rxbuffer[0]
+      if (writeOk(rxbuffer, read_N))                                                   // check return values for ACK
+      {
+         state = 4;                                // goto next state
+         if (debug)
+            printf("Write ok (ACK: 0x%02X)\n",rxbuffer[0]);
       }
    }
 
@@ -697,9 +1468,11 @@ unsigned char i_task(HANDLE* hComm)
    char rxbuffer[RX_BUFFER_SIZE];   // receive buffer
    int  read_N;                     // number of valid bytes in rx buffer
    int  write_N;                    // number of valid bytes in tx buffer
+   stats_phase(PHASE_SCAN);
    txbuffer[0] = 's';               // send 'Scan' command
-   WriteFile(*hComm, txbuffer, 1, &write_N, NULL);
-   ReadFile(*hComm, rxbuffer, RX_BUFFER_SIZE, &read_N, NULL);                // must return 0xNN 0xNN 0xNN 0xFF (0xNN are addresses)
+   port_write(hComm, txbuffer, 1, &write_N, txbuffer[0]);
+   read_reply_until(hComm, rxbuffer, 8+1, UART_END, &read_N);                // must return 0xNN 0xNN 0xNN 0xFF (0xNN are addresses)
+   stats_reply();
    if ((read_N>1) && ((unsigned char)rxbuffer[read_N-1]==(unsigned char)0xFF)) // at least one address was detected
    {
       if (verbose_on)
@@ -730,9 +1503,11 @@ unsigned char p_task(HANDLE* hComm)
    char rxbuffer[RX_BUFFER_SIZE];   // receive buffer
    int  read_N;                     // number of valid bytes in rx buffer
    int  write_N;                    // number of valid bytes in tx buffer
+   stats_phase(PHASE_SCAN);
    txbuffer[0] = 'p';               // send 'p' command for reading present pin
-   WriteFile(*hComm, txbuffer, 1, &write_N, NULL);
-   ReadFile(*hComm, rxbuffer, RX_BUFFER_SIZE, &read_N, NULL); // one byte must be returned
+   port_write(hComm, txbuffer, 1, &write_N, txbuffer[0]);
+   read_reply(hComm, rxbuffer, 1, &read_N);                     // one byte must be returned
+   stats_reply();
    if (read_N==1)                                               // one byte must be returned
    {
       return rxbuffer[0];
@@ -745,16 +1520,70 @@ unsigned char p_task(HANDLE* hComm)
    }
 }
 
+/*
+ * -T option
+ *  Print and reset the profiling counters of the FMC FRU Programmer
+ *  every command is split into USB receive, I2C address phase, I2C data phase, write cycle and USB transmit,
+ *  the firmware counts min, max and total time of each phase in timer ticks
+ *  the task returns 1 on success
+ */
+int T_task(HANDLE* hComm)
+{
+   static const char* phase_names[PROF_PHASES] = { "USB receive", "I2C address", "I2C data", "write cycle", "USB transmit" };
+   unsigned char rxbuffer[RX_BUFFER_SIZE];                     // receive buffer for T command
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for T command
+   int  read_N;                                                // number of valid bytes in rx buffer
+   int  write_N;                                               // number of valid bytes in tx buffer
+   int  N_reply = 7 + 16*PROF_PHASES;                          // ACK, tick, phases, commands, 4 counters per phase
+   unsigned int  tick_us;                                      // length of a timer tick
+   unsigned int  commands;                                     // commands counted by firmware
+   unsigned int  v[4];                                         // count, min, max, total of a phase
+   unsigned char* p;
+
+   if (fw_version < FW_PROFILE)
+   {
+      printf("\nFirmware %02X.%02X.%02X has no profiling counters!\n",
+             (fw_version >> 16) & 0xFF, (fw_version >> 8) & 0xFF, fw_version & 0xFF);
+      return 0;
+   }
+   txbuffer[0] = 'T';                                          // send 'T' command for profiling counters
+   port_write(hComm, txbuffer, 1, &write_N, txbuffer[0]);
+   read_reply(hComm, rxbuffer, N_reply, &read_N);              // must return ACK, tick length, number of phases and counters
+   stats_reply();
+   if ((read_N != N_reply) || (rxbuffer[0] != UART_ACK) || (rxbuffer[2] != PROF_PHASES))
+   {
+      printf("\nError while reading profiling counters!\n");
+      return 0;
+   }
+   tick_us  = rxbuffer[1];
+   commands = (rxbuffer[3] << 24) | (rxbuffer[4] << 16) | (rxbuffer[5] << 8) | rxbuffer[6];
+   printf("\nFirmware profile of %u commands (timer resolution %u us):\n", commands, tick_us);
+   printf("   %-14s%10s%12s%12s%12s%14s\n", "phase", "commands", "min [us]", "avg [us]", "max [us]", "total [ms]");
+   for (int i=0; i<PROF_PHASES; i++)
+   {
+      p = rxbuffer + 7 + 16*i;
+      for (int j=0; j<4; j++)
+         v[j] = (p[4*j] << 24) | (p[4*j+1] << 16) | (p[4*j+2] << 8) | p[4*j+3];
+      printf("   %-14s%10u%12.0f%12.0f%12.0f%14.3f\n", phase_names[i], v[0],
+             (double)v[1] * tick_us, v[0] ? (double)v[3] * tick_us / v[0] : 0.0,
+             (double)v[2] * tick_us, (double)v[3] * tick_us / 1000.0);
+   }
+   return 1;
+}
+
 /*
  * -s option
- *  Scan serial ports for FMC FRU Programmer
+ *  Scan serial ports for FMC FRU Programmer, only the port given with -c is tried if set
  *  the task returns a valid handle for the serial port
  */
 int s_task(HANDLE* hComm)
 {
    int ret = 0;    // default return value
+   stats_phase(PHASE_DISCOVERY);
+   if (port_name)
+      ret = open_serial_port(port_name, hComm);
    // FOR LOOP TO SCAN ALL WINDOWS COM PORTS
-   for (unsigned char n=1; n <= WIN_COM_PORT_MAX_NO; n++)
+   for (unsigned char n=1; (n <= WIN_COM_PORT_MAX_NO) && !port_name; n++)
    {
       ret = init_serial_port(n, hComm);
       if (ret)     // SUCCESS
@@ -770,7 +1599,7 @@ int s_task(HANDLE* hComm)
       if (verbose_on)
          printf("\nNo FMC FRU Programmer connected!\n");
 
-      CloseHandle(*hComm);
+      port_close(hComm);
       return 0;
    }
    else
@@ -792,10 +1621,12 @@ unsigned char r_task(HANDLE* hComm, unsigned char read_burst)
    int  write_N;                                               // number of valid bytes in tx buffer
    txbuffer[0] = 'b';                                          // send  0x62 b = bytes to read in a burst command
    txbuffer[1] = read_burst;                                   // append read burst size
-   WriteFile(*hComm, txbuffer, 2, &write_N, NULL);             // execute command on I2C bus
-   ReadFile(*hComm, rxbuffer, RX_BUFFER_SIZE, &read_N, NULL);  // must return 0x06 (0x06 is ACK)
+   port_write(hComm, txbuffer, 2, &write_N, txbuffer[0]);             // execute command on I2C bus
+   read_reply(hComm, rxbuffer, 2, &read_N);                    // must return 0x06 (0x06 is ACK) and the new value
+   stats_reply();
    if (readOk(rxbuffer,read_N))                                // check
    {
+      device_read_burst = read_burst;                          // programmer replies with this length from now on
       if (verbose_on)
       {
          printf("\nSet read burst length: %d\n",read_burst);
@@ -807,20 +1638,11 @@ unsigned char r_task(HANDLE* hComm, unsigned char read_burst)
 }
 
 /*
- *  Initialize the serial port
- *  Default parameters are 115200 Baud, 8 bit data, 1 Startbit, 1 Stopbit, No parity
+ *  Initialize the serial port COMn
  */
 int init_serial_port(unsigned char n, HANDLE* hComport)
 {
-   HANDLE hTest;
    char portname[16];                                      // stores string "COMx"
-   DCB dcbSerialParams       = { 0 };                      // Initializing DCB structure
-   COMMTIMEOUTS timeouts     = { 0 };                      // Initializing Timeout structure
-   BOOL Status;                                            // Status of the various operations 
-   char txbuffer[TX_BUFFER_SIZE];                          // transmit buffer
-   char rxbuffer[RX_BUFFER_SIZE];                          // receive buffer
-   int  read_N;                                            // number of valid bytes in rx buffer      
-   int  write_N;                                           // number of valid bytes in tx buffer      
 
    if (n<10)
       snprintf(portname,3+1+1,"COM%d",n);                  // COM0 .. COM9
@@ -828,45 +1650,44 @@ int init_serial_port(unsigned char n, HANDLE* hComport)
       snprintf(portname,4+3+2+1,"\\\\.\\COM%d",n);         // \\.\COM10 .. \\.\COM99
    else
       snprintf(portname,4+3+3+1,"\\\\.\\COM%d",n);         // \\.\COM100 .. \\.\COM255
-      
-   hTest     = CreateFile(portname,                        // port name
-                      GENERIC_READ | GENERIC_WRITE,        // Read/Write
-                      0,                                   // No Sharing
-                      NULL,                                // No Security
-                      OPEN_EXISTING,                       // Open existing port only
-                      0,                                   // Non Overlapped I/O
-                      NULL);                               // Null for Comm Devices
+
+   return open_serial_port(portname, hComport);
+}
+
+/*
+ *  Open the serial port portname and check if an FMC FRU Programmer answers
+ *  Default parameters are 115200 Baud, 8 bit data, 1 Startbit, 1 Stopbit, No parity
+ */
+int open_serial_port(char* portname, HANDLE* hComport)
+{
+   HANDLE hTest;
+   char txbuffer[TX_BUFFER_SIZE];                          // transmit buffer
+   char rxbuffer[RX_BUFFER_SIZE];                          // receive buffer
+   int  read_N;                                            // number of valid bytes in rx buffer      
+   int  write_N;                                           // number of valid bytes in tx buffer      
+
+   hTest = port_open(portname);
 
    if (hTest == INVALID_HANDLE_VALUE)
    {   
        // NO SUCCESS  
-       CloseHandle(hTest); // Closing the Serial Port
+       port_close(&hTest); // Closing the Serial Port
    }
    else
    {    
       // SUCCESS, portname exists
-      dcbSerialParams.DCBlength = sizeof(dcbSerialParams);  
-      GetCommState(hTest, &dcbSerialParams);
-      dcbSerialParams.BaudRate             = CBR_115200;         // Setting BaudRate = 115200
-      dcbSerialParams.ByteSize             = 8;                  // Setting ByteSize = 8
-      dcbSerialParams.StopBits             = ONESTOPBIT;         // Setting StopBits = 1
-      dcbSerialParams.Parity               = NOPARITY;           // Setting Parity = None
-      //dcbSerialParams.fRtsControl          = RTS_CONTROL_ENABLE; // Enables the RTS line when the device is opened and leaves it on
-      //dcbSerialParams.fDtrControl          = DTR_CONTROL_ENABLE; // Enables the DTR line when the device is opened and leaves it on
-      SetCommState(hTest, &dcbSerialParams);                     // Configuring the port according to settings in DCB 
-      
-      timeouts.ReadIntervalTimeout         = 80;          // in milliseconds
-      timeouts.ReadTotalTimeoutConstant    = 10;          // in milliseconds
-      timeouts.ReadTotalTimeoutMultiplier  = 50;          // in milliseconds
-      timeouts.WriteTotalTimeoutConstant   = 10;          // in milliseconds
-      timeouts.WriteTotalTimeoutMultiplier = 10;          // in milliseconds
-      SetCommTimeouts(hTest, &timeouts);                  // Configuring the timeouts
-
       txbuffer[0] = 'v';                                  // send 'Version' command
-      WriteFile(hTest, txbuffer, 1, &write_N, NULL);
-      ReadFile(hTest, rxbuffer, RX_BUFFER_SIZE, &read_N, NULL); // must return 0xNN 0xNN 0xNN 0xFF (0xNN are version numbers)   
+      port_write(&hTest, txbuffer, 1, &write_N, txbuffer[0]);
+      read_reply(&hTest, rxbuffer, 4, &read_N);           // must return 0xNN 0xNN 0xNN 0xFF (0xNN are version numbers)
+      stats_reply();
       if ((read_N == 4) && ((unsigned char)rxbuffer[read_N-1]==(unsigned char)0xFF))
       {         
+         txbuffer[0] = 'b';                               // query current read burst length, replies are read with exact length
+         port_write(&hTest, txbuffer, 1, &write_N, txbuffer[0]);
+         read_reply(&hTest, rxbuffer+4, 1, &read_N);      // must return 0xNN (current read burst length)
+         stats_reply();
+         device_read_burst = (read_N == 1) ? rxbuffer[4] : 0;
+         fw_version        = FW_VERSION(rxbuffer[0],rxbuffer[1],rxbuffer[2]);
          if (verbose_on)
          {
             printf("\n");
@@ -877,73 +1698,419 @@ int init_serial_port(unsigned char n, HANDLE* hComport)
          *hComport = hTest;                               // copy serial port handle
          return 1;                                        // return success
       } 
-      CloseHandle(hTest);                                 // Closing the serial port, no FMC FRU Programmer detected
+      port_close(&hTest);                                 // Closing the serial port, no FMC FRU Programmer detected
    }
    return 0;
 }
 
 /*
- *  read one byte from FMC FRU Programmer
- *  Using 1 byte addresses
- *  On successful read, rx buffer contains 0x06 (ACK) and data
+ *  Read a reply with known length from FMC FRU Programmer
+ *  Returns as soon as N_expected bytes arrived, the RX_TIMEOUT_MS deadline is only hit in error cases
  */
-void read_from_eeprom(unsigned char i2c_addr, unsigned char addr, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+int read_reply(HANDLE* hComm, unsigned char* rxbuffer, int N_expected, int* read_N)
 {
-   char txbuffer[TX_BUFFER_SIZE];                               // transmit buffer for read command
-   txbuffer[0] = 'r';                                           // send 'read (1 byte addressing)' command
-   txbuffer[1] = i2c_addr;                                      // append i2s address of eeprom
-   txbuffer[2] = addr;                                          // append addr to read
-   WriteFile(*hComm, txbuffer, 3, read_N, NULL);                  // execute command on I2C bus
-   ReadFile(*hComm, rxbuffer, RX_BUFFER_SIZE, read_N, NULL);   // must return 0x06 0xNN (0x06 is ACK 0xNN is data)
+   DWORD n;                                                    // number of bytes returned by one ReadFile call
+
+   *read_N = 0;
+   while (*read_N < N_expected)
+   {
+      if (!port_read(hComm, rxbuffer + *read_N, N_expected - *read_N, &n) || (n == 0))
+         break;                                                // deadline expired, reply is incomplete
+      *read_N = *read_N + n;
+   }
+   return *read_N;
 }
 
 /*
- *  Read one byte from FMC FRU Programmer
- *  Using 2 byte addresses
- *  On successful read, rx buffer contains 0x06 (ACK) and data
+ *  Read a reply with variable length from FMC FRU Programmer
+ *  Returns as soon as the end character arrived or N_max bytes were read
  */
-void Read_from_eeprom(unsigned char i2c_addr, unsigned int addr, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+int read_reply_until(HANDLE* hComm, unsigned char* rxbuffer, int N_max, unsigned char end, int* read_N)
 {
-   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
-   txbuffer[0] = 'R';                                          // send 'Read (2 byte addressing)' command
-   txbuffer[1] = i2c_addr;                                     // append i2c address of eeprom
-   txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);      // append addr (MSB) to read (0x0000)
-   txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);      // append addr (LSB) to read (0x0000)
-   WriteFile(*hComm, txbuffer, 4, read_N, NULL);                 // execute command on I2C bus   
-   ReadFile(*hComm, rxbuffer, RX_BUFFER_SIZE, read_N, NULL);  // must return 0x06 0xNN (0x06 is ACK 0xNN is data)
+   DWORD n;                                                    // number of bytes returned by one ReadFile call
+
+   *read_N = 0;
+   while (*read_N < N_max)
+   {
+      if (!port_read(hComm, rxbuffer + *read_N, 1, &n) || (n == 0))
+         break;                                                // deadline expired, reply is incomplete
+      *read_N = *read_N + 1;
+      if (rxbuffer[*read_N-1] == end)
+         break;                                                // end of transmission
+   }
+   return *read_N;
 }
 
 /*
- *  write one byte to FMC FRU Programmer
- *  Using 1 byte addresses
- *  On successful write, rx buffer contains 0x06 (ACK)
+ *  Read N_bytes from EEPROM into image, starting at address 0x0000
+ *  Up to read_depth read commands are kept in flight, replies are matched to the commands in order
+ *  Returns the number of bytes read successfully
  */
-void write_to_eeprom(unsigned char i2c_addr, unsigned char addr, unsigned char txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+unsigned int read_image(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int N_bytes, unsigned char read_burst, int read_depth, unsigned char* image)
 {
-   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
-   txbuffer[0] = 'w';                                          // send 'write (1 byte addressing)' command
-   txbuffer[1] = i2c_addr;                                     // append i2c address of eeprom
-   txbuffer[2] = addr;                                         // append addr to write (0x00)
-   txbuffer[3] = txbyte;                                       // append value to write
-   WriteFile(*hComm, txbuffer, 4, read_N, NULL);                 // execute command on I2C bus
-   ReadFile(*hComm, rxbuffer, 1, read_N, NULL);                // must return 0x06 (0x06 is ACK)
+   if (fw_version >= FW_FRAMES)              // CRC protected frames, several in flight
+      return read_frames(hComm, i2c_addr, N_addr, N_bytes, read_depth, image);
+   if (fw_version >= FW_BULKREAD)            // complete image with one command
+      return read_range(hComm, i2c_addr, N_addr, 0x0000, N_bytes, image);
+   return read_commands(hComm, i2c_addr, N_addr, N_bytes, read_burst, read_depth, image);
 }
 
 /*
- *  Write one byte to FMC FRU Programmer
- *  Using 2 byte addresses
- *  On successful write, rx buffer contains 0x06 (ACK)
+ *  Read N_bytes from EEPROM into image with r/R commands of read_burst bytes, starting at address 0x0000
+ *  read_burst must match the burst length of FMC FRU Programmer, image must hold N_bytes + read_burst bytes
+ *  Returns the number of bytes read successfully
  */
-void Write_to_eeprom(unsigned char i2c_addr, unsigned int addr, unsigned char txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+unsigned int read_commands(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int N_bytes, unsigned char read_burst, int read_depth, unsigned char* image)
 {
-   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
-   txbuffer[0] = 'W';                                          // send 'Write (2 byte addressing)' command
-   txbuffer[1] = i2c_addr;                                     // append i2c address of eeprom
-   txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);      // append addr (MSB) to read (0x0000)
-   txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);      // append addr (LSB) to read (0x0000)
-   txbuffer[4] = txbyte;                                       // append value to write
-   WriteFile(*hComm, txbuffer, 5, read_N, NULL);                 // execute command on I2C bus
-   ReadFile(*hComm, rxbuffer, 1, read_N, NULL);                // must return 0x06 (0x06 is ACK)
+   unsigned char rxbuffer[RX_BUFFER_SIZE];   // receive buffer for one reply
+   int           read_N;                     // number of valid bytes in rx buffer
+   unsigned int  tx_addr = 0;                // address of the next read command to send
+   unsigned int  rx_addr = 0;                // address of the next reply to receive
+   double        t_sent[READ_DEPTH_MAX];     // send time of commands in flight
+
+   while (rx_addr < N_bytes)
+   {
+      while ((tx_addr < N_bytes) && (tx_addr - rx_addr < (unsigned int)read_depth * read_burst))
+      {
+         t_sent[(tx_addr / read_burst) % READ_DEPTH_MAX] = time_us();
+         send_read_command(i2c_addr, N_addr, tx_addr, hComm);   // refill window
+         tx_addr = tx_addr + read_burst;
+      }
+
+      read_reply(hComm, rxbuffer, 1+read_burst, &read_N);       // reply for the oldest command in flight
+      stats_reply();
+      if (!readOk(rxbuffer, read_N))
+      {
+         printf("\nError during readout, EEPROM returns no ACK on Read command!\n");
+         break;
+      }
+      bench_command(t_sent[(rx_addr / read_burst) % READ_DEPTH_MAX]);
+      memcpy(image+rx_addr, rxbuffer+1, read_burst);            // skip first position (its the ACK)
+      rx_addr = rx_addr + read_burst;
+
+      if (verbose_on)
+      {
+         printf("%3.1f%%\r", (float)(rx_addr) / (float)(N_bytes) * 100.0);
+         fflush(stdout);
+      }
+   }
+   return (rx_addr < N_bytes) ? rx_addr : N_bytes;
+}
+
+/*
+ *  Read N_bytes (1 .. 65536) from EEPROM into image, starting at address addr
+ *  The firmware runs one sequential I2C read and streams the data back in full USB packets
+ *  Returns the number of bytes read successfully
+ */
+unsigned int read_range(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int addr, unsigned int N_bytes, unsigned char* image)
+{
+   char          txbuffer[TX_BUFFER_SIZE];   // transmit buffer for range read command
+   unsigned char ack;                        // first byte of reply
+   int           write_N;                    // number of valid bytes in tx buffer
+   int           read_N;                     // number of bytes returned by read_reply
+   unsigned int  rx_N = 0;                   // number of data bytes received
+   unsigned int  N;                          // number of bytes for next read_reply call
+   double        t_sent = time_us();         // send time of command
+
+   if (N_addr == 2)
+   {
+      txbuffer[0] = 'D';                                       // send 'Dump (2 byte addressing)' command
+      txbuffer[1] = i2c_addr;                                  // append i2c address of eeprom
+      txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);   // append addr (MSB) to read
+      txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);   // append addr (LSB) to read
+      txbuffer[4] = (unsigned char)0x000000FF & (N_bytes >> 8);// append length (MSB), 0x0000 is 65536 bytes
+      txbuffer[5] = (unsigned char)0x000000FF & (N_bytes >> 0);// append length (LSB)
+      port_write(hComm, txbuffer, 6, &write_N, txbuffer[0]);
+   }
+   else
+   {
+      txbuffer[0] = 'd';                                       // send 'dump (1 byte addressing)' command
+      txbuffer[1] = i2c_addr;                                  // append i2c address of eeprom
+      txbuffer[2] = (unsigned char)0x000000FF & addr;          // append addr to read
+      txbuffer[3] = (unsigned char)0x000000FF & (N_bytes >> 8);// append length (MSB), 0x0000 is 65536 bytes
+      txbuffer[4] = (unsigned char)0x000000FF & (N_bytes >> 0);// append length (LSB)
+      port_write(hComm, txbuffer, 5, &write_N, txbuffer[0]);
+   }
+
+   read_reply(hComm, &ack, 1, &read_N);                        // must return 0x06 (0x06 is ACK) followed by the data
+   if ((read_N != 1) || (ack != UART_ACK))
+   {
+      stats_reply();
+      printf("\nError during readout, EEPROM returns no ACK on Dump command!\n");
+      return 0;
+   }
+
+   while (rx_N < N_bytes)
+   {
+      N = (N_bytes - rx_N > BULK_CHUNK) ? BULK_CHUNK : N_bytes - rx_N;
+      if (read_reply(hComm, image+rx_N, N, &read_N) != (int)N)
+      {
+         printf("\nError during readout, reply is incomplete!\n");
+         rx_N = rx_N + read_N;
+         break;
+      }
+      rx_N = rx_N + N;
+
+      if (verbose_on)
+      {
+         printf("%3.1f%%\r", (float)(rx_N) / (float)(N_bytes) * 100.0);
+         fflush(stdout);
+      }
+   }
+   stats_reply();
+   if (rx_N == N_bytes)
+      bench_command(t_sent);
+   return rx_N;
+}
+
+/*
+ *  Read N_bytes from EEPROM into image with d/D frames of protocol v2, starting at address 0x0000
+ *  Up to read_depth frames of FRAME_RANGE_MAX bytes are in flight, replies are matched by sequence number
+ *  A corrupted reply is requested again after the programmer is quiet, at most FRAME_RETRIES times in a row
+ *  Returns the number of bytes read successfully
+ */
+unsigned int read_frames(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int N_bytes, int read_depth, unsigned char* image)
+{
+   static unsigned char reply[1+FRAME_RANGE_MAX]; // status and data of one reply
+   unsigned char payload[5];                  // i2c addr, addr (1 or 2 bytes), length (2 bytes)
+   unsigned char opcode  = (N_addr == 2) ? 'D' : 'd';
+   unsigned int  tx_addr = 0;                 // address of next request
+   unsigned int  rx_addr = 0;                 // address of next reply
+   unsigned char tx_seq  = 0;                 // sequence number of next request
+   unsigned char rx_seq  = 0;                 // sequence number of next reply
+   int           in_flight = 0;               // number of requests without reply
+   int           retries   = 0;               // retries of current reply
+   int           status;                      // status of received frame
+   int           read_N;                      // payload bytes of received frame
+   unsigned int  N;                           // data bytes of a frame
+   double        t_sent[256];                 // send time of frames, indexed by sequence number
+
+   while (rx_addr < N_bytes)
+   {
+      while ((in_flight < read_depth) && (tx_addr < N_bytes))
+      {
+         N = (N_bytes - tx_addr > FRAME_RANGE_MAX) ? FRAME_RANGE_MAX : N_bytes - tx_addr;
+         payload[0] = i2c_addr;
+         if (N_addr == 2)
+            payload[1] = (unsigned char)0x000000FF & (tx_addr >> 8); // append addr (MSB) to read
+         payload[N_addr]   = (unsigned char)0x000000FF & tx_addr;    // append addr (LSB) to read
+         payload[N_addr+1] = (unsigned char)0x000000FF & (N >> 8);   // append length (MSB)
+         payload[N_addr+2] = (unsigned char)0x000000FF & N;          // append length (LSB)
+         t_sent[tx_seq] = time_us();
+         send_frame(hComm, opcode, tx_seq, payload, N_addr+3);
+         tx_addr   = tx_addr + N;
+         tx_seq    = tx_seq + 1;
+         in_flight = in_flight + 1;
+      }
+
+      N         = (N_bytes - rx_addr > FRAME_RANGE_MAX) ? FRAME_RANGE_MAX : N_bytes - rx_addr;
+      status    = read_frame(hComm, opcode, rx_seq, reply, 1+N, &read_N);
+      stats_reply();
+      in_flight = in_flight - 1;
+      if ((status == FRAME_OK) && (read_N == (int)(1+N)) && (reply[0] == UART_ACK))
+      {
+         bench_command(t_sent[rx_seq]);
+         memcpy(image+rx_addr, reply+1, N);
+         rx_addr = rx_addr + N;
+         rx_seq  = rx_seq + 1;
+         retries = 0;
+
+         if (verbose_on)
+         {
+            printf("%3.1f%%\r", (float)(rx_addr) / (float)(N_bytes) * 100.0);
+            fflush(stdout);
+         }
+         continue;
+      }
+      if ((status == FRAME_OK) && (reply[0] == UART_NACK))
+      {
+         printf("\nError during readout, EEPROM returns no ACK on Dump frame (addr 0x%04X)!\n",rx_addr);
+         break;
+      }
+
+      retries = retries + 1;                  // reply or request was corrupted on USB
+      if (retries > FRAME_RETRIES)
+      {
+         printf("\nError during readout, corrupted reply (status 0x%02X) at addr 0x%04X!\n",status,rx_addr);
+         break;
+      }
+      drain_input(hComm);                     // discard replies of requests in flight
+      stats_retry(STATS_FRAME + opcode);
+      in_flight = 0;
+      tx_addr   = rx_addr;                    // request again with new sequence numbers
+      rx_seq    = tx_seq;
+   }
+   return rx_addr;
+}
+
+/*
+ *  CRC-8 of protocol v2 frames, polynomial x^8 + x^2 + x + 1 (0x07), covers opcode, seq, length and payload
+ */
+unsigned char crc8(unsigned char crc, unsigned char* data, int N)
+{
+   for (int i=0; i<N; i++)
+   {
+      crc = crc ^ data[i];
+      for (int bit=0; bit<8; bit++)
+         crc = (crc & 0x80) ? (unsigned char)((crc << 1) ^ 0x07) : (unsigned char)(crc << 1);
+   }
+   return crc;
+}
+
+/*
+ *  Send request frame with N payload bytes to FMC FRU Programmer, the reply is not awaited
+ *  Frames do not depend on USB packet boundaries, several requests may be sent back to back
+ */
+void send_frame(HANDLE* hComm, unsigned char opcode, unsigned char seq, unsigned char* payload, int N)
+{
+   unsigned char txbuffer[TX_BUFFER_SIZE];   // transmit buffer for frame
+   int           write_N;                    // number of valid bytes in tx buffer
+
+   txbuffer[0] = FRAME_SOF;
+   txbuffer[1] = opcode;
+   txbuffer[2] = seq;
+   txbuffer[3] = (unsigned char)0x000000FF & (N >> 8);
+   txbuffer[4] = (unsigned char)0x000000FF & N;
+   memcpy(txbuffer+FRAME_HEADER, payload, N);
+   txbuffer[FRAME_HEADER+N] = crc8(0, txbuffer+1, FRAME_HEADER-1+N);
+   port_write(hComm, txbuffer, FRAME_HEADER+N+1, &write_N, STATS_FRAME + opcode);
+}
+
+/*
+ *  Receive reply frame for request opcode/seq, the payload (status and data) is stored in payload
+ *  Returns FRAME_OK or the reason why the frame is not valid
+ */
+int read_frame(HANDLE* hComm, unsigned char opcode, unsigned char seq, unsigned char* payload, int N_max, int* N)
+{
+   unsigned char header[FRAME_HEADER];       // SOF, opcode, seq, length
+   unsigned char crc;                        // CRC-8 of reply
+   int           read_N;                     // number of bytes returned by read_reply
+
+   *N = 0;
+   if (read_reply(hComm, header, FRAME_HEADER, &read_N) != FRAME_HEADER)
+      return FRAME_TIMEOUT;
+   if (header[0] != FRAME_SOF)
+      return FRAME_MISMATCH;
+   *N = (header[3] << 8) | header[4];
+   if (*N > N_max)
+      return FRAME_TOOLONG;
+   if (read_reply(hComm, payload, *N, &read_N) != *N)
+      return FRAME_TIMEOUT;
+   if (read_reply(hComm, &crc, 1, &read_N) != 1)
+      return FRAME_TIMEOUT;
+   if (crc != crc8(crc8(0, header+1, FRAME_HEADER-1), payload, *N))
+      return FRAME_BADCRC;
+   if ((header[1] != opcode) || (header[2] != seq))
+      return FRAME_MISMATCH;
+   return FRAME_OK;
+}
+
+/*
+ *  Discard everything FMC FRU Programmer sends until it is quiet for RX_TIMEOUT_MS
+ */
+void drain_input(HANDLE* hComm)
+{
+   unsigned char rxbuffer[RX_BUFFER_SIZE];   // discarded data
+   int           read_N;                     // number of bytes returned by read_reply
+
+   stats_flush();
+   do
+   {
+      read_reply(hComm, rxbuffer, RX_BUFFER_SIZE, &read_N);
+   } while (read_N > 0);
+}
+
+/*
+ *  Send read command to FMC FRU Programmer, the reply is not awaited
+ *  Every command is sent with its own WriteFile call, so it ends up in its own USB packet
+ */
+void send_read_command(unsigned char i2c_addr, unsigned char N_addr, unsigned int addr, HANDLE* hComm)
+{
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
+   int  write_N;                                               // number of valid bytes in tx buffer
+   if (N_addr == 2)
+   {
+      txbuffer[0] = 'R';                                       // send 'Read (2 byte addressing)' command
+      txbuffer[1] = i2c_addr;                                  // append i2c address of eeprom
+      txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);   // append addr (MSB) to read
+      txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);   // append addr (LSB) to read
+      port_write(hComm, txbuffer, 4, &write_N, txbuffer[0]);
+   }
+   else
+   {
+      txbuffer[0] = 'r';                                       // send 'read (1 byte addressing)' command
+      txbuffer[1] = i2c_addr;                                  // append i2c address of eeprom
+      txbuffer[2] = (unsigned char)0x000000FF & addr;          // append addr to read
+      port_write(hComm, txbuffer, 3, &write_N, txbuffer[0]);
+   }
+}
+
+/*
+ *  read one byte from FMC FRU Programmer
+ *  Using 1 byte addresses
+ *  On successful read, rx buffer contains 0x06 (ACK) and data
+ */
+void read_from_eeprom(unsigned char i2c_addr, unsigned char addr, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+{
+   char txbuffer[TX_BUFFER_SIZE];                               // transmit buffer for read command
+   txbuffer[0] = 'r';                                           // send 'read (1 byte addressing)' command
+   txbuffer[1] = i2c_addr;                                      // append i2s address of eeprom
+   txbuffer[2] = addr;                                          // append addr to read
+   port_write(hComm, txbuffer, 3, read_N, txbuffer[0]);                  // execute command on I2C bus
+   read_reply(hComm, rxbuffer, 1+device_read_burst, read_N);    // must return 0x06 0xNN (0x06 is ACK 0xNN is data)
+   stats_reply();
+}
+
+/*
+ *  Read one byte from FMC FRU Programmer
+ *  Using 2 byte addresses
+ *  On successful read, rx buffer contains 0x06 (ACK) and data
+ */
+void Read_from_eeprom(unsigned char i2c_addr, unsigned int addr, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+{
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
+   txbuffer[0] = 'R';                                          // send 'Read (2 byte addressing)' command
+   txbuffer[1] = i2c_addr;                                     // append i2c address of eeprom
+   txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);      // append addr (MSB) to read (0x0000)
+   txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);      // append addr (LSB) to read (0x0000)
+   port_write(hComm, txbuffer, 4, read_N, txbuffer[0]);                 // execute command on I2C bus   
+   read_reply(hComm, rxbuffer, 1+device_read_burst, read_N);   // must return 0x06 0xNN (0x06 is ACK 0xNN is data)
+   stats_reply();
+}
+
+/*
+ *  write one byte to FMC FRU Programmer
+ *  Using 1 byte addresses
+ *  On successful write, rx buffer contains 0x06 (ACK)
+ */
+void write_to_eeprom(unsigned char i2c_addr, unsigned char addr, unsigned char txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+{
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
+   txbuffer[0] = 'w';                                          // send 'write (1 byte addressing)' command
+   txbuffer[1] = i2c_addr;                                     // append i2c address of eeprom
+   txbuffer[2] = addr;                                         // append addr to write (0x00)
+   txbuffer[3] = txbyte;                                       // append value to write
+   port_write(hComm, txbuffer, 4, read_N, txbuffer[0]);                 // execute command on I2C bus
+   read_reply(hComm, rxbuffer, 1, read_N);                     // must return 0x06 (0x06 is ACK)
+   stats_reply();
+}
+
+/*
+ *  Write one byte to FMC FRU Programmer
+ *  Using 2 byte addresses
+ *  On successful write, rx buffer contains 0x06 (ACK)
+ */
+void Write_to_eeprom(unsigned char i2c_addr, unsigned int addr, unsigned char txbyte, unsigned char* rxbuffer, int* read_N, HANDLE* hComm)
+{
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for read command
+   txbuffer[0] = 'W';                                          // send 'Write (2 byte addressing)' command
+   txbuffer[1] = i2c_addr;                                     // append i2c address of eeprom
+   txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);      // append addr (MSB) to read (0x0000)
+   txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);      // append addr (LSB) to read (0x0000)
+   txbuffer[4] = txbyte;                                       // append value to write
+   port_write(hComm, txbuffer, 5, read_N, txbuffer[0]);                 // execute command on I2C bus
+   read_reply(hComm, rxbuffer, 1, read_N);                     // must return 0x06 (0x06 is ACK)
+   stats_reply();
 }
 
 /*
@@ -961,9 +2128,11 @@ void write_to_eeprom_burst(unsigned char i2c_addr, unsigned char addr, unsigned
    {
       txbuffer[3+i] = txbyte[i];                               // append value to write
    }
-   WriteFile(*hComm, txbuffer, 3+N_txbyte, read_N, NULL);        // execute command on I2C bus
-   Sleep(5);
-   ReadFile(*hComm, rxbuffer, 1, read_N, NULL);                // must return 0x06 (0x06 is ACK)
+   port_write(hComm, txbuffer, 3+N_txbyte, read_N, txbuffer[0]);        // execute command on I2C bus
+   if (fw_version < FW_ACKPOLL)                                // older firmware replies before the EEPROM write cycle is finished
+      port_sleep(5);
+   read_reply(hComm, rxbuffer, 1, read_N);                     // must return 0x06 (0x06 is ACK)
+   stats_reply();
 }
 
 /*
@@ -983,16 +2152,174 @@ void Write_to_eeprom_burst(unsigned char i2c_addr, unsigned int addr, unsigned c
       txbuffer[4+i] = txbyte[i];                               // append value to write
    }
 
-   WriteFile(*hComm, txbuffer, 4+N_txbyte, read_N, NULL);        // execute command on I2C bus
-   if     (N_txbyte>=32)
-      Sleep(20);
-   else if(N_txbyte>=16)
-      Sleep(10);
-   else if(N_txbyte>=8)
-      Sleep(5);
+   port_write(hComm, txbuffer, 4+N_txbyte, read_N, txbuffer[0]);        // execute command on I2C bus
+   if (fw_version < FW_ACKPOLL)                                // older firmware replies before the EEPROM write cycle is finished
+   {
+      if     (N_txbyte>=32)
+         port_sleep(20);
+      else if(N_txbyte>=16)
+         port_sleep(10);
+      else if(N_txbyte>=8)
+         port_sleep(5);
+      else
+         port_sleep(1);
+   }
+   read_reply(hComm, rxbuffer, 1, read_N);                     // must return 0x06 (0x06 is ACK)
+   stats_reply();
+}
+
+/*
+ *  Write N_bytes (1 .. STREAM_RANGE_MAX) from data to EEPROM, starting at address addr
+ *  The data is sent in chunks that never cross a multiple of burst, burst must divide the EEPROM page size
+ *  FMC FRU Programmer grants every free chunk buffer with UART_CREDIT and receives the next chunk
+ *  during the write cycle of the current one, the reply ends with UART_END after the last write cycle
+ *  Returns the number of bytes written successfully
+ */
+unsigned int write_range(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned int addr, unsigned char* data, unsigned int N_bytes, unsigned char burst)
+{
+   char          txbuffer[TX_BUFFER_SIZE];   // transmit buffer for streaming write command
+   unsigned char rx;                         // reply byte
+   int           write_N;                    // number of valid bytes in tx buffer
+   int           read_N;                     // number of bytes returned by read_reply
+   unsigned int  tx_N    = 0;                // number of data bytes sent
+   unsigned int  N;                          // number of bytes of next chunk
+   int           credits = 0;                // number of chunks FMC FRU Programmer is able to receive
+
+   if (N_addr == 2)
+   {
+      txbuffer[0] = 'U';                                       // send 'Upload (2 byte addressing)' command
+      txbuffer[1] = i2c_addr;                                  // append i2c address of eeprom
+      txbuffer[2] = (unsigned char)0x000000FF & (addr >> 8);   // append addr (MSB) to write
+      txbuffer[3] = (unsigned char)0x000000FF & (addr >> 0);   // append addr (LSB) to write
+      txbuffer[4] = (unsigned char)0x000000FF & (N_bytes >> 8);// append length (MSB)
+      txbuffer[5] = (unsigned char)0x000000FF & (N_bytes >> 0);// append length (LSB)
+      txbuffer[6] = burst;                                     // append chunk size
+      port_write(hComm, txbuffer, 7, &write_N, txbuffer[0]);
+   }
    else
-      Sleep(1);
-   ReadFile(*hComm, rxbuffer, 1, read_N, NULL);                // must return 0x06 (0x06 is ACK)
+   {
+      txbuffer[0] = 'u';                                       // send 'upload (1 byte addressing)' command
+      txbuffer[1] = i2c_addr;                                  // append i2c address of eeprom
+      txbuffer[2] = (unsigned char)0x000000FF & addr;          // append addr to write
+      txbuffer[3] = (unsigned char)0x000000FF & (N_bytes >> 8);// append length (MSB)
+      txbuffer[4] = (unsigned char)0x000000FF & (N_bytes >> 0);// append length (LSB)
+      txbuffer[5] = burst;                                     // append chunk size
+      port_write(hComm, txbuffer, 6, &write_N, txbuffer[0]);
+   }
+
+   read_reply(hComm, &rx, 1, &read_N);                         // must return 0x06 (0x06 is ACK) followed by the credits
+   if ((read_N != 1) || (rx != UART_ACK))
+   {
+      stats_reply();
+      printf("\nError during upload, EEPROM returns no ACK on Upload command (addr 0x%04X)!\n",addr);
+      return 0;
+   }
+
+   while (1)
+   {
+      if ((credits > 0) && (tx_N < N_bytes))                   // send next chunk, every chunk ends up in its own USB packet
+      {
+         N = burst - ((addr + tx_N) % burst);
+         if (N > N_bytes - tx_N)
+            N = N_bytes - tx_N;
+         port_write(hComm, data+tx_N, N, &write_N, STATS_DATA);
+         tx_N    = tx_N + N;
+         credits = credits - 1;
+
+         if (verbose_on)
+         {
+            printf("%3.1f%%\r", (float)(tx_N) / (float)(N_bytes) * 100.0);
+            fflush(stdout);
+         }
+         continue;
+      }
+
+      read_reply(hComm, &rx, 1, &read_N);
+      if ((read_N == 1) && (rx == UART_CREDIT))
+         credits = credits + 1;
+      else if ((read_N == 1) && (rx == UART_END) && (tx_N == N_bytes))
+      {
+         stats_reply();
+         return N_bytes;
+      }
+      else
+      {
+         stats_reply();
+         printf("\nError during upload, EEPROM returns no ACK on Upload command (addr 0x%04X)!\n",addr+tx_N);
+         return 0;
+      }
+   }
+}
+
+/*
+ *  Set the I2C clock of FMC FRU Programmer to the fastest clock not above khz
+ *  SCL = F_CPU / (16 + 2 * TWBR * 4^TWPS), the fastest clock is F_CPU / 16
+ *  Returns the clock reached in kHz, 0 on error
+ */
+unsigned int set_i2c_clock(HANDLE* hComm, unsigned int khz)
+{
+   unsigned char rxbuffer[RX_BUFFER_SIZE];                     // receive buffer for c command
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for c command
+   int  read_N;                                                // number of valid bytes in rx buffer
+   int  write_N;                                               // number of valid bytes in tx buffer
+   int  twbr = 255;                                            // TWI bit rate register
+   int  twps;                                                  // TWI prescaler, 4^TWPS
+
+   if (khz == 0)
+      return 0;
+
+   for (twps=0; twps<4; twps++)                                // smallest prescaler with TWBR in range
+   {
+      twbr = (int)ceil(((double)PROGRAMMER_F_CPU / (khz * 1000.0) - 16.0) / (2.0 * pow(4, twps)));
+      if (twbr < 0)
+         twbr = 0;
+      if (twbr <= 255)
+         break;
+   }
+   if (twps == 4)                                              // slower than slowest clock
+   {
+      twps = 3;
+      twbr = 255;
+   }
+
+   txbuffer[0] = 'c';                                          // send 'clock' command
+   txbuffer[1] = (unsigned char)twbr;                          // append bit rate register
+   txbuffer[2] = (unsigned char)twps;                          // append prescaler
+   port_write(hComm, txbuffer, 3, &write_N, txbuffer[0]);
+
+   read_reply(hComm, rxbuffer, 3, &read_N);                    // must return 0x06 (0x06 is ACK), TWBR, TWPS
+   stats_reply();
+   if ((read_N != 3) || (rxbuffer[0] != UART_ACK))
+      return 0;
+   return i2c_clock_khz(rxbuffer[1], rxbuffer[2]);
+}
+
+/*
+ *  I2C clock in kHz for TWI bit rate register and prescaler of FMC FRU Programmer
+ */
+unsigned int i2c_clock_khz(unsigned char twbr, unsigned char twps)
+{
+   return PROGRAMMER_F_CPU / (16 + 2 * twbr * (1 << (2 * (twps & 0x03)))) / 1000;
+}
+
+/*
+ *  Read duration of the last EEPROM write cycle from FMC FRU Programmer
+ *  The firmware measures it while ACK polling the EEPROM after a write command
+ */
+unsigned int write_cycle_time(HANDLE* hComm)
+{
+   unsigned char rxbuffer[RX_BUFFER_SIZE];                     // receive buffer for t command
+   char txbuffer[TX_BUFFER_SIZE];                              // transmit buffer for t command
+   int  read_N;                                                // number of valid bytes in rx buffer
+   int  write_N;                                               // number of valid bytes in tx buffer
+   txbuffer[0] = 't';                                          // send 't' command for reading write cycle time
+   port_write(hComm, txbuffer, 1, &write_N, txbuffer[0]);
+   read_reply(hComm, rxbuffer, 3, &read_N);                    // must return 0x06 0xNN 0xNN (ACK, time MSB, time LSB)
+   stats_reply();
+   if (readOk(rxbuffer, read_N) == 3)
+      return (rxbuffer[1] << 8) | rxbuffer[2];
+   else
+      return 0;
 }
 
 /*
@@ -1097,6 +2424,812 @@ int TestIfSizeIs(unsigned int n, unsigned char i2c_addr, unsigned char addressin
    }
 }
 
+/*
+ *  Split an image of N_image bytes into write commands, starting at address 0x0000
+ *  Every command stays within one EEPROM page and carries at most max_burst bytes (0: largest burst of firmware),
+ *  so a full page goes out with the fewest commands and the tail with one short command
+ *  Returns the number of write commands in plan
+ */
+int plan_writes(unsigned int N_image, unsigned int page_size, unsigned char max_burst, write_op* plan, int max_ops)
+{
+   unsigned int addr = 0;                      // start address of next write command
+   unsigned int N;                             // number of bytes of next write command
+   int          N_ops = 0;                     // number of write commands in plan
+
+   max_burst = write_burst_length(0, max_burst);
+   if (page_size == 0)
+      page_size = 1;
+
+   while ((addr < N_image) && (N_ops < max_ops))
+   {
+      N = page_size - (addr % page_size);      // bytes up to next page boundary
+      if (N > max_burst)
+         N = max_burst;
+      if (N > N_image - addr)
+         N = N_image - addr;                   // tail
+      plan[N_ops].addr = addr;
+      plan[N_ops].N    = (unsigned char)N;
+      N_ops            = N_ops + 1;
+      addr             = addr + N;
+   }
+   return N_ops;
+}
+
+/*
+ *  Largest write command of a plan, page_size 0 ignores the page size
+ *  Streaming writes carry up to STREAM_BURST_MAX bytes, single W commands are limited to WRITE_BURST_MAX bytes by the USB packet
+ */
+unsigned char write_burst_length(unsigned int page_size, unsigned char max_burst)
+{
+   unsigned char burst_max = (fw_version >= FW_STREAMWRITE) ? STREAM_BURST_MAX : WRITE_BURST_MAX;
+
+   if ((max_burst == 0) || (max_burst > burst_max))
+      max_burst = burst_max;
+   if ((page_size != 0) && (page_size < max_burst))
+      max_burst = (unsigned char)page_size;
+   return max_burst;
+}
+
+/*
+ *  Remove write commands from plan whose data is already stored in the EEPROM
+ *  The remaining write commands are moved to the front of plan, order is kept
+ *  Returns the number of remaining write commands
+ */
+int diff_plan(unsigned char* image, unsigned char* eeprom, write_op* plan, int N_ops)
+{
+   int N_diff = 0;                             // number of write commands with changed data
+
+   for (int i=0; i<N_ops; i++)
+   {
+      if (memcmp(image+plan[i].addr, eeprom+plan[i].addr, plan[i].N) != 0)
+      {
+         plan[N_diff] = plan[i];
+         N_diff       = N_diff + 1;
+      }
+   }
+   return N_diff;
+}
+
+/*
+ *  Number of EEPROM pages touched by the write commands of plan
+ *  Write commands never cross a page boundary and are sorted by address
+ */
+int count_pages(write_op* plan, int N_ops, unsigned int page_size)
+{
+   int          N_pages = 0;                   // number of pages
+   unsigned int page;                          // page of current write command
+   unsigned int last    = 0;                   // page of previous write command
+
+   for (int i=0; i<N_ops; i++)
+   {
+      page = plan[i].addr / page_size;
+      if ((i == 0) || (page != last))
+         N_pages = N_pages + 1;
+      last = page;
+   }
+   return N_pages;
+}
+
+/*
+ *  Smallest page size of 24Cxx EEPROMs with N_bytes size
+ *  24C01/02: 8 bytes, 24C04/08/16: 16 bytes, 24C32/64: 32 bytes, 24C128/256: 64 bytes, 24C512: 128 bytes
+ */
+unsigned int default_page_size(unsigned int N_bytes)
+{
+   if (N_bytes <= 256)
+      return 8;
+   else if (N_bytes <= 2048)
+      return 16;
+   else if (N_bytes <= 8192)
+      return 32;
+   else if (N_bytes <= 32768)
+      return 64;
+   else
+      return 128;
+}
+
+/*
+ *  Execute the write commands of a plan, data is taken from image at the command addresses
+ *  burst is the largest write command of the plan, see write_burst_length()
+ *  Newer firmware streams every run of adjacent write commands with one u/U command
+ *  Returns the number of write commands acknowledged by FMC FRU Programmer
+ */
+int write_image(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned char* image, write_op* plan, int N_ops, unsigned char burst)
+{
+   if ((fw_version >= FW_STREAMWRITE) && ((N_addr == 1) || (N_addr == 2)))
+      return write_streams(hComm, i2c_addr, N_addr, image, plan, N_ops, burst);
+   return write_commands(hComm, i2c_addr, N_addr, image, plan, N_ops);
+}
+
+/*
+ *  Execute the write commands of a plan with u/U streaming writes, one for every run of adjacent write commands
+ *  Returns the number of write commands written successfully
+ */
+int write_streams(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned char* image, write_op* plan, int N_ops, unsigned char burst)
+{
+   unsigned int  N;                            // number of bytes of a run
+   double        t_sent;                       // send time of u/U command
+   int           i, j;
+
+   for (i=0; i<N_ops; i=j)
+   {
+      for (j=i+1; j<N_ops; j++)                // find end of run, write commands are sorted by address
+      {
+         if (plan[j].addr != plan[j-1].addr + plan[j-1].N)
+            break;
+         if (plan[j].addr + plan[j].N - plan[i].addr > STREAM_RANGE_MAX)
+            break;
+      }
+      N      = plan[j-1].addr + plan[j-1].N - plan[i].addr;
+      t_sent = time_us();
+      if (write_range(hComm, i2c_addr, N_addr, plan[i].addr, image+plan[i].addr, N, burst) != N)
+         break;
+      bench_command(t_sent);
+   }
+   return i;
+}
+
+/*
+ *  Execute the write commands of a plan with one w/W command each
+ *  Returns the number of write commands acknowledged by FMC FRU Programmer
+ */
+int write_commands(HANDLE* hComm, unsigned char i2c_addr, unsigned char N_addr, unsigned char* image, write_op* plan, int N_ops)
+{
+   unsigned char rxbuffer[RX_BUFFER_SIZE];     // receive buffer for ACK
+   int           read_N;                       // received bytes
+   double        t_sent;                       // send time of w/W command
+   int           i;
+
+   for (i=0; i<N_ops; i++)
+   {
+      t_sent = time_us();
+      if (N_addr == 2)
+         Write_to_eeprom_burst(i2c_addr, plan[i].addr, image+plan[i].addr, plan[i].N, rxbuffer, &read_N, hComm); // burst write with 2 byte addressing
+      else if (N_addr == 1)
+         write_to_eeprom_burst(i2c_addr, plan[i].addr, image+plan[i].addr, plan[i].N, rxbuffer, &read_N, hComm); // burst write with 1 byte addressing
+      else
+      {
+         printf("\nError during upload, address width (%d) is not valid\n",N_addr);
+         break;
+      }
+
+      if (!writeOk(rxbuffer, read_N))
+      {
+         printf("\nError during upload, EEPROM returns no ACK on Write command (addr 0x%04X)!\n",plan[i].addr);
+         break;
+      }
+      bench_command(t_sent);
+
+      if (verbose_on)
+      {
+         printf("%3.1f%%\r", (float)(i+1) / (float)(N_ops) * 100.0);
+         fflush(stdout);
+      }
+   }
+   return i;
+}
+
+/*
+ *  High resolution time stamp in us
+ */
+double time_us(void)
+{
+   LARGE_INTEGER count;                        // performance counter
+   LARGE_INTEGER freq;                         // counts per second
+
+   QueryPerformanceCounter(&count);
+   QueryPerformanceFrequency(&freq);
+   return (double)count.QuadPart * 1000000.0 / (double)freq.QuadPart;
+}
+
+/*
+ *  Open the serial port portname with 115200 Baud, 8 bit data, 1 Startbit, 1 Stopbit, No parity
+ *  ReadFile returns as soon as the requested bytes arrived or after RX_TIMEOUT_MS
+ *  During replay (-y) the port opens if the next port session of the trace was recorded for portname
+ */
+HANDLE port_open(char* portname)
+{
+   HANDLE hTest;
+   DCB dcbSerialParams       = { 0 };                      // Initializing DCB structure
+   COMMTIMEOUTS timeouts     = { 0 };                      // Initializing Timeout structure
+
+   if (replay)
+   {
+      replay->open = -1;
+      if ((replay->next >= replay->N_rec) || (replay->rec[replay->next].type != TRACE_OPEN) ||
+          (replay->rec[replay->next].N != (int)strlen(portname)) ||
+          memcmp(replay->rec[replay->next].data, portname, replay->rec[replay->next].N))
+         return INVALID_HANDLE_VALUE;                      // port was not opened at this point of the recording
+      replay->open     = replay->next;
+      for (replay->end = replay->next + 1; replay->end < replay->N_rec; replay->end++)
+      {
+         if (replay->rec[replay->end].type == TRACE_OPEN)
+            break;                                         // port was not closed in the recording
+         if (replay->rec[replay->end].type == TRACE_CLOSE)
+         {
+            replay->end = replay->end + 1;
+            break;
+         }
+      }
+      replay->tx_pos   = replay->open + 1;
+      replay->tx_off   = 0;
+      replay->rx_pos   = replay->open + 1;
+      replay->rx_off   = 0;
+      replay->t_open   = time_us();
+      replay->diverged = 0;
+      hTest = (HANDLE)replay;                              // any handle but INVALID_HANDLE_VALUE
+   }
+   else
+   {
+      hTest     = CreateFile(portname,                        // port name
+                         GENERIC_READ | GENERIC_WRITE,        // Read/Write
+                         0,                                   // No Sharing
+                         NULL,                                // No Security
+                         OPEN_EXISTING,                       // Open existing port only
+                         0,                                   // Non Overlapped I/O
+                         NULL);                               // Null for Comm Devices
+      if (hTest == INVALID_HANDLE_VALUE)
+         return hTest;
+
+      dcbSerialParams.DCBlength = sizeof(dcbSerialParams);  
+      GetCommState(hTest, &dcbSerialParams);
+      dcbSerialParams.BaudRate             = CBR_115200;         // Setting BaudRate = 115200
+      dcbSerialParams.ByteSize             = 8;                  // Setting ByteSize = 8
+      dcbSerialParams.StopBits             = ONESTOPBIT;         // Setting StopBits = 1
+      dcbSerialParams.Parity               = NOPARITY;           // Setting Parity = None
+      //dcbSerialParams.fRtsControl          = RTS_CONTROL_ENABLE; // Enables the RTS line when the device is opened and leaves it on
+      //dcbSerialParams.fDtrControl          = DTR_CONTROL_ENABLE; // Enables the DTR line when the device is opened and leaves it on
+      SetCommState(hTest, &dcbSerialParams);                     // Configuring the port according to settings in DCB 
+      
+      timeouts.ReadIntervalTimeout         = 0;              // ReadFile returns as soon as the requested bytes arrived ...
+      timeouts.ReadTotalTimeoutConstant    = RX_TIMEOUT_MS;  // ... or when the deadline expired, in milliseconds
+      timeouts.ReadTotalTimeoutMultiplier  = 0;              // in milliseconds
+      timeouts.WriteTotalTimeoutConstant   = 10;          // in milliseconds
+      timeouts.WriteTotalTimeoutMultiplier = 10;          // in milliseconds
+      SetCommTimeouts(hTest, &timeouts);                  // Configuring the timeouts
+   }
+   if (trace)
+      trace_record(TRACE_OPEN, portname, strlen(portname));
+   return hTest;
+}
+
+/*
+ *  Close the serial port, invalid handles are ignored
+ */
+void port_close(HANDLE* hComm)
+{
+   if (replay)
+   {
+      if ((replay->open < 0) || (*hComm != (HANDLE)replay))
+         return;
+      replay->next = replay->end;                          // bytes not requested by the host are skipped
+      replay->open = -1;
+   }
+   else if (!CloseHandle(*hComm))
+      return;
+   if (trace)
+      trace_record(TRACE_CLOSE, NULL, 0);
+}
+
+/*
+ *  WriteFile for all commands and data sent to FMC FRU Programmer
+ *  cmd is the command type for -S, a command waits for its reply in a queue, STATS_DATA continues the previous command
+ */
+BOOL port_write(HANDLE* hComm, void* data, int N, int* write_N, int cmd)
+{
+   BOOL ok;
+   int  i;
+
+   if (replay)
+      ok = replay_write(data, N, write_N);
+   else
+      ok = WriteFile(*hComm, data, N, (DWORD*)write_N, NULL);
+   if (trace)
+      trace_record(TRACE_TX, data, *write_N);
+   if (stats == NULL)
+      return ok;
+   if (cmd != STATS_DATA)
+   {
+      if (stats->N_pending == STATS_PENDING)             // reply of oldest command is lost
+         stats_reply();
+      i = (stats->head + stats->N_pending) % STATS_PENDING;
+      stats->pending_cmd[i]     = cmd & (2*STATS_FRAME-1);
+      stats->pending_time[i]    = time_us();
+      stats->pending_timeout[i] = 0;
+      stats->N_pending          = stats->N_pending + 1;
+      stats->last               = cmd & (2*STATS_FRAME-1);
+      stats->cmd[stats->last].commands++;
+      stats->phase[stats->current].commands++;
+   }
+   if (stats->last != STATS_DATA)
+      stats->cmd[stats->last].tx_bytes += *write_N;
+   stats->phase[stats->current].tx_bytes += *write_N;
+   return ok;
+}
+
+/*
+ *  ReadFile for all replies of FMC FRU Programmer
+ *  Received bytes and timeouts are counted for the oldest command without reply
+ */
+BOOL port_read(HANDLE* hComm, void* data, int N, DWORD* read_N)
+{
+   double t_start = time_us();
+   BOOL   ok;
+   int    cmd;
+
+   if (replay)
+      ok = replay_read(data, N, read_N);
+   else
+      ok = ReadFile(*hComm, data, N, read_N, NULL);
+   if (trace)
+      trace_record(TRACE_RX, data, *read_N);         // a record without data marks a timeout
+   if (stats == NULL)
+      return ok;
+
+   cmd     = stats->N_pending ? stats->pending_cmd[stats->head] : stats->last;
+   stats->phase[stats->current].read_seconds += (time_us() - t_start) / 1000000.0;
+   stats->phase[stats->current].rx_bytes     += *read_N;
+   if (cmd != STATS_DATA)
+      stats->cmd[cmd].rx_bytes += *read_N;
+   if (*read_N == 0)                                     // deadline expired
+   {
+      stats->phase[stats->current].timeouts++;
+      if (cmd != STATS_DATA)
+         stats->cmd[cmd].timeouts++;
+      if (stats->N_pending)
+         stats->pending_timeout[stats->head] = 1;
+   }
+   return ok;
+}
+
+/*
+ *  Sleep, the time is counted for the current phase
+ *  the host waits for FMC FRU Programmer, so the time is scaled like the recorded delays during replay
+ */
+void port_sleep(DWORD ms)
+{
+   double t_start = time_us();
+
+   if (replay)
+      replay_wait(t_start + ms * 1000.0 * replay->scale);
+   else
+      Sleep(ms);
+   if (stats)
+      stats->phase[stats->current].sleep_seconds += (time_us() - t_start) / 1000000.0;
+}
+
+/*
+ *  The reply of the oldest command without reply is complete, or it will not arrive anymore
+ *  The latency is recorded unless a ReadFile call timed out while waiting for the reply
+ */
+void stats_reply(void)
+{
+   cmd_stats* c;
+   double     latency;
+   int        bucket;
+
+   if ((stats == NULL) || (stats->N_pending == 0))
+      return;
+   c       = &stats->cmd[stats->pending_cmd[stats->head]];
+   latency = time_us() - stats->pending_time[stats->head];
+   if (!stats->pending_timeout[stats->head])
+   {
+      for (bucket=0; (bucket < STATS_BUCKETS-1) && (latency >= 16.0 * (1 << bucket)); bucket++)
+         ;
+      c->histogram[bucket]++;
+      c->latency_sum = c->latency_sum + latency;
+      if (latency > c->latency_max)
+         c->latency_max = latency;
+      c->replies++;
+   }
+   stats->head      = (stats->head + 1) % STATS_PENDING;
+   stats->N_pending = stats->N_pending - 1;
+}
+
+/*
+ *  Count a command that is sent again after a corrupted reply
+ */
+void stats_retry(int cmd)
+{
+   if (stats)
+      stats->cmd[cmd & (2*STATS_FRAME-1)].retries++;
+}
+
+/*
+ *  Replies of all commands without reply are discarded
+ */
+void stats_flush(void)
+{
+   if (stats)
+      stats->N_pending = 0;
+}
+
+/*
+ *  End the current phase and begin the next one
+ */
+void stats_phase(int phase)
+{
+   double now;
+
+   if (stats == NULL)
+      return;
+   now = time_us();
+   stats->phase[stats->current].seconds += (now - stats->t_phase) / 1000000.0;
+   stats->current = phase;
+   stats->t_phase = now;
+}
+
+/*
+ *  Write time per phase and latency histogram per command type to the file of -S as JSON
+ */
+int stats_report(void)
+{
+   static const char* phase_names[PHASE_N] = { "discovery", "i2c_scan", "autodetect", "transfer" };
+   FILE*        fp;
+   phase_stats* p;
+   cmd_stats*   c;
+   int          first = 1;
+
+   stats_phase(stats->current);                          // count time of current phase
+   fp = fopen(stats->filename, "w");
+   if (fp == NULL)
+   {
+      printf("\nCannot open file %s\n",stats->filename);
+      return 0;
+   }
+   fprintf(fp, "{\n  \"tool\": \"%d.%d.%d\",\n  \"firmware\": \"%02X.%02X.%02X\",\n  \"phases\": {\n",
+           REVISION_MAJOR, REVISION_MINOR, BUILD_NUMBER, (fw_version >> 16) & 0xFF, (fw_version >> 8) & 0xFF, fw_version & 0xFF);
+   for (int i=0; i<PHASE_N; i++)
+   {
+      p = &stats->phase[i];
+      fprintf(fp, "    \"%s\": {\"seconds\": %.6f, \"read_seconds\": %.6f, \"sleep_seconds\": %.6f, \"commands\": %u, "
+                  "\"tx_bytes\": %llu, \"rx_bytes\": %llu, \"timeouts\": %u}%s\n",
+              phase_names[i], p->seconds, p->read_seconds, p->sleep_seconds, p->commands,
+              p->tx_bytes, p->rx_bytes, p->timeouts, (i < PHASE_N-1) ? "," : "");
+   }
+   fprintf(fp, "  },\n  \"commands\": [");
+   for (int i=0; i<2*STATS_FRAME; i++)
+   {
+      c = &stats->cmd[i];
+      if (c->commands == 0)
+         continue;
+      fprintf(fp, "%s\n    {\"command\": \"%s%c\", \"commands\": %u, \"replies\": %u, \"timeouts\": %u, \"retries\": %u, "
+                  "\"tx_bytes\": %llu, \"rx_bytes\": %llu, \"latency_mean_us\": %.1f, \"latency_max_us\": %.1f,\n     \"histogram\": [",
+              first ? "" : ",", (i >= STATS_FRAME) ? "frame_" : "", (i & 0xFF), c->commands, c->replies, c->timeouts, c->retries,
+              c->tx_bytes, c->rx_bytes, c->replies ? c->latency_sum / c->replies : 0.0, c->latency_max);
+      first = 0;
+      for (int b=0, n=0; b<STATS_BUCKETS; b++)
+      {
+         if (c->histogram[b] == 0)
+            continue;
+         if (b < STATS_BUCKETS-1)
+            fprintf(fp, "%s{\"below_us\": %d, \"count\": %u}", n ? ", " : "", 16 << b, c->histogram[b]);
+         else
+            fprintf(fp, "%s{\"below_us\": null, \"count\": %u}", n ? ", " : "", c->histogram[b]);
+         n = n + 1;
+      }
+      fprintf(fp, "]}");
+   }
+   fprintf(fp, "\n  ]\n}\n");
+   fclose(fp);
+   printf("\nStatistics written to %s\n",stats->filename);
+   return 1;
+}
+
+/*
+ *  Start recording all serial port traffic to filename
+ */
+int trace_open(char* filename)
+{
+   trace = (trace_log*)calloc(1, sizeof(trace_log));
+   if (trace == NULL)
+      return 0;
+   trace->fp = fopen(filename, "wb");
+   if (trace->fp == NULL)
+   {
+      free(trace);
+      trace = NULL;
+      return 0;
+   }
+   fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), trace->fp);
+   fputc(TRACE_VERSION, trace->fp);
+   trace->t_last = time_us();
+   return 1;
+}
+
+/*
+ *  Append a record with the time since the previous record to the trace file
+ *  Data longer than 65535 bytes is split into several records
+ */
+void trace_record(unsigned char type, void* data, int N)
+{
+   unsigned char  header[TRACE_HEADER];
+   unsigned char* p   = (unsigned char*)data;
+   double         now = time_us();
+   unsigned int   dt  = (unsigned int)(now - trace->t_last);
+   int            n;
+
+   trace->t_last = trace->t_last + dt;                 // rounding errors do not add up
+   do
+   {
+      n         = (N > 0xFFFF) ? 0xFFFF : N;
+      header[0] = type;
+      header[1] = dt & 0xFF;
+      header[2] = (dt >> 8) & 0xFF;
+      header[3] = (dt >> 16) & 0xFF;
+      header[4] = (dt >> 24) & 0xFF;
+      header[5] = n & 0xFF;
+      header[6] = (n >> 8) & 0xFF;
+      fwrite(header, 1, TRACE_HEADER, trace->fp);
+      if (n)
+         fwrite(p, 1, n, trace->fp);
+      p  = p + n;
+      N  = N - n;
+      dt = 0;
+   } while (N > 0);
+}
+
+/*
+ *  Load a trace recorded with -t, the serial port is replaced by the recorded FMC FRU Programmer from now on
+ *  scale multiplies all recorded delays
+ */
+int replay_load(char* filename, double scale)
+{
+   unsigned char* file;                        // trace file content, stays in memory for the record data
+   unsigned int   filesize;
+   unsigned int   pos;
+   double         t = 0.0;                     // us since begin of trace
+   int            N;
+
+   file = load_image(filename, &filesize);
+   if (file == NULL)
+      return 0;
+   pos = strlen(TRACE_MAGIC) + 1;
+   if ((filesize < pos) || memcmp(file, TRACE_MAGIC, pos-1) || (file[pos-1] != TRACE_VERSION))
+   {
+      printf("\n%s is no trace file of version %d\n",filename,TRACE_VERSION);
+      free(file);
+      return 0;
+   }
+   replay = (replay_log*)calloc(1, sizeof(replay_log));
+   if (replay == NULL)
+      return 0;
+   replay->rec   = (trace_rec*)calloc(filesize / TRACE_HEADER + 1, sizeof(trace_rec));
+   replay->scale = (scale > 0.0) ? scale : 0.0;
+   replay->open  = -1;
+   while (pos + TRACE_HEADER <= filesize)
+   {
+      N = file[pos+5] | (file[pos+6] << 8);
+      if (pos + TRACE_HEADER + N > filesize)
+         break;                                // recording was interrupted
+      t = t + (file[pos+1] | (file[pos+2] << 8) | (file[pos+3] << 16) | ((unsigned int)file[pos+4] << 24));
+      replay->rec[replay->N_rec].type = file[pos];
+      replay->rec[replay->N_rec].t    = t;
+      replay->rec[replay->N_rec].N    = N;
+      replay->rec[replay->N_rec].data = file + pos + TRACE_HEADER;
+      replay->N_rec = replay->N_rec + 1;
+      pos = pos + TRACE_HEADER + N;
+   }
+   return 1;
+}
+
+/*
+ *  Bytes sent by the host during replay must be the recorded ones
+ *  The recorded FMC FRU Programmer does not answer anymore after the first difference
+ */
+BOOL replay_write(unsigned char* data, int N, int* write_N)
+{
+   trace_rec* r;
+
+   *write_N = N;
+   for (int i=0; (i < N) && !replay->diverged; i++)
+   {
+      while ((replay->tx_pos < replay->end) && (replay->rec[replay->tx_pos].type != TRACE_TX))
+         replay->tx_pos = replay->tx_pos + 1;
+      r = &replay->rec[replay->tx_pos];
+      if ((replay->open < 0) || (replay->tx_pos >= replay->end) || (r->data[replay->tx_off] != data[i]))
+      {
+         printf("\nReplay differs from trace at record %d, the host sent 0x%02X\n",replay->tx_pos,data[i]);
+         replay->diverged = 1;
+         break;
+      }
+      replay->tx_off = replay->tx_off + 1;
+      if (replay->tx_off == r->N)
+      {
+         r->t_replay    = time_us();
+         replay->tx_pos = replay->tx_pos + 1;
+         replay->tx_off = 0;
+      }
+   }
+   return TRUE;
+}
+
+/*
+ *  ReadFile during replay
+ *  A received record is available after all bytes sent before it were sent again by the host,
+ *  it arrives with the recorded delay to the last of these bytes, multiplied by the scale of -y
+ *  The time stamp of a record is the end of its ReadFile call, so a record arrives at the deadline at the latest
+ *  Returns after N bytes, at a recorded timeout or after the scaled RX_TIMEOUT_MS like ReadFile
+ */
+BOOL replay_read(unsigned char* data, int N, DWORD* read_N)
+{
+   double     deadline = time_us() + RX_TIMEOUT_MS * 1000.0 * replay->scale;
+   double     t_ref;                           // recorded time of last record sent by host
+   double     t_start;                         // replayed time of that record
+   double     t_rx;                            // replayed time of received record
+   trace_rec* r;
+   int        n;
+
+   *read_N = 0;
+   while ((int)*read_N < N)
+   {
+      while ((replay->rx_pos < replay->end) && (replay->rec[replay->rx_pos].type != TRACE_RX))
+         replay->rx_pos = replay->rx_pos + 1;
+      while ((replay->tx_pos < replay->end) && (replay->rec[replay->tx_pos].type != TRACE_TX))
+         replay->tx_pos = replay->tx_pos + 1;                  // next record the host has to send
+      if ((replay->open < 0) || replay->diverged || (replay->rx_pos >= replay->end) || (replay->rx_pos > replay->tx_pos))
+         break;                                // FMC FRU Programmer waits for the host
+      t_ref   = replay->rec[replay->open].t;
+      t_start = replay->t_open;
+      for (int i=replay->rx_pos-1; i > replay->open; i--)
+      {
+         if (replay->rec[i].type == TRACE_TX)
+         {
+            t_ref   = replay->rec[i].t;
+            t_start = replay->rec[i].t_replay;
+            break;
+         }
+      }
+      r = &replay->rec[replay->rx_pos];
+      if (r->N == 0)
+      {
+         replay->rx_pos = replay->rx_pos + 1;  // ReadFile returned without data in the recording
+         break;
+      }
+      t_rx = t_start + (r->t - t_ref) * replay->scale;
+      replay_wait((t_rx < deadline) ? t_rx : deadline);
+      n = r->N - replay->rx_off;
+      if (n > N - (int)*read_N)
+         n = N - *read_N;
+      memcpy(data + *read_N, r->data + replay->rx_off, n);
+      *read_N        = *read_N + n;
+      replay->rx_off = replay->rx_off + n;
+      if (replay->rx_off == r->N)
+      {
+         replay->rx_pos = replay->rx_pos + 1;
+         replay->rx_off = 0;
+      }
+   }
+   if ((int)*read_N < N)
+      replay_wait(deadline);                   // ReadFile returns at its deadline
+   return TRUE;
+}
+
+/*
+ *  Wait until the time stamp t of time_us()
+ */
+void replay_wait(double t)
+{
+   double now = time_us();
+
+   while (now < t)
+   {
+      if (t - now > 2000.0)
+         Sleep((DWORD)((t - now) / 1000.0) - 1);
+      now = time_us();
+   }
+}
+
+/*
+ *  Record the latency of a command sent at t_sent, the reply was just received completely
+ *  Nothing is recorded unless a benchmark is running
+ */
+void bench_command(double t_sent)
+{
+   if (bench == NULL)
+      return;
+   if (bench->N < BENCH_LATENCY_MAX)
+      bench->latency[bench->N++] = time_us() - t_sent;
+   bench->commands++;
+}
+
+int compare_double(const void* a, const void* b)
+{
+   return (*(double*)a > *(double*)b) - (*(double*)a < *(double*)b);
+}
+
+/*
+ *  Complete result of a benchmark run started at t_start with the commands recorded in log, print it
+ */
+void bench_stats(bench_log* log, bench_result* result, double t_start)
+{
+   result->seconds  = (time_us() - t_start) / 1000000.0;
+   result->commands = log->commands;
+   result->p50_us   = 0.0;
+   result->p99_us   = 0.0;
+   if (log->N > 0)
+   {
+      qsort(log->latency, log->N, sizeof(double), compare_double);
+      result->p50_us = log->latency[(log->N * 50 + 99) / 100 - 1];   // nearest rank
+      result->p99_us = log->latency[(log->N * 99 + 99) / 100 - 1];
+   }
+   printf("   %-8s %-6s %3d: %6d bytes %9.0f bytes/s %8.1f commands/s  p50 %8.0f us  p99 %8.0f us  %s\n",
+          result->op, result->method, result->burst, result->bytes, result->bytes / result->seconds,
+          result->commands / result->seconds, result->p50_us, result->p99_us, result->ok ? "ok" : "FAILED");
+}
+
+/*
+ *  Write benchmark results to filename, JSON if the name ends with .json, CSV otherwise
+ */
+int bench_report(bench_result* results, int N_results, char* filename)
+{
+   FILE*        fp;                            // report file
+   size_t       len  = strlen(filename);
+   int          json = (len >= 5) && (strcmp(filename+len-5, ".json") == 0);
+   bench_result* r;
+
+   fp = fopen(filename, "w");
+   if (fp == NULL)
+   {
+      printf("\nCannot open file %s\n",filename);
+      return 0;
+   }
+   if (json)
+      fprintf(fp, "[\n");
+   else
+      fprintf(fp, "op,method,burst,addr_bytes,eeprom_bytes,bytes,seconds,bytes_per_s,commands,commands_per_s,p50_us,p99_us,ok\n");
+
+   for (int i=0; i<N_results; i++)
+   {
+      r = &results[i];
+      if (json)
+         fprintf(fp, "  {\"op\": \"%s\", \"method\": \"%s\", \"burst\": %d, \"addr_bytes\": %d, \"eeprom_bytes\": %d, \"bytes\": %d, "
+                     "\"seconds\": %.6f, \"bytes_per_s\": %.1f, \"commands\": %d, \"commands_per_s\": %.1f, "
+                     "\"p50_us\": %.1f, \"p99_us\": %.1f, \"ok\": %s}%s\n",
+                 r->op, r->method, r->burst, r->N_addr, r->eeprom_bytes, r->bytes, r->seconds, r->bytes / r->seconds,
+                 r->commands, r->commands / r->seconds, r->p50_us, r->p99_us, r->ok ? "true" : "false", (i < N_results-1) ? "," : "");
+      else
+         fprintf(fp, "%s,%s,%d,%d,%d,%d,%.6f,%.1f,%d,%.1f,%.1f,%.1f,%d\n",
+                 r->op, r->method, r->burst, r->N_addr, r->eeprom_bytes, r->bytes, r->seconds, r->bytes / r->seconds,
+                 r->commands, r->commands / r->seconds, r->p50_us, r->p99_us, r->ok);
+   }
+   if (json)
+      fprintf(fp, "]\n");
+   fclose(fp);
+   printf("\nBenchmark report written to %s\n",filename);
+   return 1;
+}
+
+/*
+ *  Read a complete file into memory
+ *  Returns the file content (release with free), NULL on error
+ */
+unsigned char* load_image(char* filename, unsigned int* filesize)
+{
+   FILE*          fp;                          // file pointer to input file
+   unsigned char* image;                       // file content
+
+   fp = fopen(filename, "rb");
+   if (fp == NULL)
+   {
+      printf("\nCannot open file %s\n",filename);
+      return NULL;
+   }
+   fseek(fp, 0, SEEK_END);                     // seek to end of file
+   *filesize = ftell(fp);                      // get filesize
+   fseek(fp, 0, SEEK_SET);                     // seek back to beginning of file
+
+   image = (unsigned char*)malloc(*filesize + 1);
+   if ((image == NULL) || (*filesize == 0) || (fread(image, 1, *filesize, fp) != *filesize))
+   {
+      printf("\nError while reading file %s\n",filename);
+      free(image);
+      image = NULL;
+   }
+   fclose(fp);
+   return image;
+}
+
 /*
  * parse rxbuffer for read ACK
  * a successful read command returns an ACK character in first positionb followed by the readout bytes
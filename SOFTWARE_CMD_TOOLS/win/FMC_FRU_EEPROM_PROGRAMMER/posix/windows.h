@@ -0,0 +1,295 @@
+// Copyright (C) 2020 IAM Electronic GmbH <info@iamelectronic.com>
+// This work is free. You can redistribute it and/or modify it under the
+// terms of the Do What The Fuck You Want To Public License, Version 2,
+// as published by Sam Hocevar. See http://www.wtfpl.net/ for more details.
+// ************************************************************************
+// File Name	  : 'posix/windows.h'
+// Title		     : Serial port functions of the Windows API for POSIX systems
+// Company		  : IAM Electronic GmbH
+// Author		  : PFH
+// Created		  : 19-MARCH-2020
+// Target OS     : Linux, macOS
+// ************************************************************************
+// Only the functions used by fmc_fru_eeprom_programmer.c are provided, e.g. to run the
+// command line tool against the simulator in FIRMWARE_ATMEL/sim:
+//    gcc -I posix -o fmc_fru_eeprom_programmer fmc_fru_eeprom_programmer.c -lm
+// A HANDLE is an index into a table of open serial ports, CloseHandle ignores everything else.
+#ifndef POSIX_WINDOWS_H
+#define POSIX_WINDOWS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef int            BOOL;
+typedef unsigned int   DWORD;          // 32 bit like on Windows
+typedef DWORD*         LPDWORD;
+typedef unsigned char  BYTE;
+typedef void*          HANDLE;
+
+#define TRUE                 1
+#define FALSE                0
+#define MAXDWORD             0xFFFFFFFF
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define GENERIC_READ         0x80000000
+#define GENERIC_WRITE        0x40000000
+#define OPEN_EXISTING        3
+#define CBR_9600             9600
+#define CBR_19200            19200
+#define CBR_38400            38400
+#define CBR_57600            57600
+#define CBR_115200           115200
+#define ONESTOPBIT           0
+#define TWOSTOPBITS          2
+#define NOPARITY             0
+#define ODDPARITY            1
+#define EVENPARITY           2
+
+typedef struct
+{
+   DWORD DCBlength;
+   DWORD BaudRate;
+   DWORD fRtsControl;
+   DWORD fDtrControl;
+   BYTE  ByteSize;
+   BYTE  Parity;
+   BYTE  StopBits;
+} DCB;
+
+typedef struct
+{
+   DWORD ReadIntervalTimeout;
+   DWORD ReadTotalTimeoutMultiplier;
+   DWORD ReadTotalTimeoutConstant;
+   DWORD WriteTotalTimeoutMultiplier;
+   DWORD WriteTotalTimeoutConstant;
+} COMMTIMEOUTS;
+
+#define POSIX_PORT_MAX 8               // serial ports open at the same time
+
+typedef struct
+{
+   int          fd;                    // file descriptor, -1 if unused
+   DCB          dcb;                   // settings of SetCommState
+   COMMTIMEOUTS timeouts;              // settings of SetCommTimeouts
+} posix_port;
+
+static posix_port posix_ports[POSIX_PORT_MAX] = { [0 ... POSIX_PORT_MAX-1] = { -1 } };
+
+static inline posix_port* posix_lookup(HANDLE h)
+{
+   intptr_t i = (intptr_t)h - 1;
+
+   if ((i < 0) || (i >= POSIX_PORT_MAX) || (posix_ports[i].fd < 0))
+      return NULL;
+   return &posix_ports[i];
+}
+
+static inline long posix_ms(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/*
+ *  Open serial port with 8N1 raw settings, input queued before the port was opened is discarded
+ */
+static inline HANDLE CreateFile(const char* name, DWORD access, DWORD share, void* security, DWORD disposition, DWORD flags, HANDLE template_file)
+{
+   struct termios tio;
+   int            i;
+   int            fd;
+
+   (void)access; (void)share; (void)security; (void)disposition; (void)flags; (void)template_file;
+   for (i=0; (i < POSIX_PORT_MAX) && (posix_ports[i].fd >= 0); i++)
+      ;
+   if (i == POSIX_PORT_MAX)
+      return INVALID_HANDLE_VALUE;
+   fd = open(name, O_RDWR | O_NOCTTY);
+   if (fd < 0)
+      return INVALID_HANDLE_VALUE;
+   if (tcgetattr(fd, &tio))
+   {
+      close(fd);                       // not a serial port
+      return INVALID_HANDLE_VALUE;
+   }
+   cfmakeraw(&tio);
+   tio.c_cflag |= CLOCAL | CREAD;
+   tcsetattr(fd, TCSANOW, &tio);
+   tcflush(fd, TCIOFLUSH);
+
+   memset(&posix_ports[i], 0, sizeof(posix_port));
+   posix_ports[i].fd           = fd;
+   posix_ports[i].dcb.BaudRate = CBR_115200;
+   posix_ports[i].dcb.ByteSize = 8;
+   return (HANDLE)(intptr_t)(i + 1);
+}
+
+static inline BOOL CloseHandle(HANDLE h)
+{
+   posix_port* port = posix_lookup(h);
+
+   if (!port)
+      return FALSE;
+   close(port->fd);
+   port->fd = -1;
+   return TRUE;
+}
+
+static inline BOOL GetCommState(HANDLE h, DCB* dcb)
+{
+   posix_port* port = posix_lookup(h);
+
+   if (!port)
+      return FALSE;
+   *dcb = port->dcb;
+   return TRUE;
+}
+
+static inline BOOL SetCommState(HANDLE h, DCB* dcb)
+{
+   posix_port*    port = posix_lookup(h);
+   struct termios tio;
+   speed_t        speed;
+
+   if (!port || tcgetattr(port->fd, &tio))
+      return FALSE;
+   switch (dcb->BaudRate)
+   {
+      case CBR_9600:  speed = B9600;   break;
+      case CBR_19200: speed = B19200;  break;
+      case CBR_38400: speed = B38400;  break;
+      case CBR_57600: speed = B57600;  break;
+      default:        speed = B115200; break;
+   }
+   cfsetispeed(&tio, speed);
+   cfsetospeed(&tio, speed);
+   tio.c_cflag &= ~(CSIZE | CSTOPB | PARENB | PARODD);
+   tio.c_cflag |= (dcb->ByteSize == 7) ? CS7 : CS8;
+   if (dcb->StopBits == TWOSTOPBITS)
+      tio.c_cflag |= CSTOPB;
+   if (dcb->Parity == ODDPARITY)
+      tio.c_cflag |= PARENB | PARODD;
+   else if (dcb->Parity == EVENPARITY)
+      tio.c_cflag |= PARENB;
+   if (tcsetattr(port->fd, TCSANOW, &tio))
+      return FALSE;
+   port->dcb = *dcb;
+   return TRUE;
+}
+
+static inline BOOL SetCommTimeouts(HANDLE h, COMMTIMEOUTS* timeouts)
+{
+   posix_port* port = posix_lookup(h);
+
+   if (!port)
+      return FALSE;
+   port->timeouts = *timeouts;
+   return TRUE;
+}
+
+/*
+ *  Read up to N bytes with the semantics of COMMTIMEOUTS
+ *  Returns when N bytes arrived, the total timeout expired or the interval timeout expired after the first byte
+ *  All timeouts 0 waits until N bytes arrived, ReadIntervalTimeout MAXDWORD alone returns immediately
+ */
+static inline BOOL ReadFile(HANDLE h, void* buffer, DWORD N, LPDWORD read_N, void* overlapped)
+{
+   posix_port*    port = posix_lookup(h);
+   COMMTIMEOUTS*  t;
+   struct pollfd  pfd;
+   long           deadline;            // end of total timeout, -1: none
+   long           wait;                // poll timeout in ms, -1: infinite
+   ssize_t        n;
+
+   (void)overlapped;
+   *read_N = 0;
+   if (!port)
+      return FALSE;
+   t          = &port->timeouts;
+   pfd.fd     = port->fd;
+   pfd.events = POLLIN;
+   if ((t->ReadTotalTimeoutConstant == 0) && (t->ReadTotalTimeoutMultiplier == 0))
+      deadline = (t->ReadIntervalTimeout == MAXDWORD) ? posix_ms() : -1;
+   else
+      deadline = posix_ms() + t->ReadTotalTimeoutConstant + (long)t->ReadTotalTimeoutMultiplier * N;
+
+   while (*read_N < N)
+   {
+      wait = (deadline < 0) ? -1 : deadline - posix_ms();
+      if ((*read_N > 0) && t->ReadIntervalTimeout && (t->ReadIntervalTimeout != MAXDWORD))
+         wait = ((wait < 0) || ((long)t->ReadIntervalTimeout < wait)) ? (long)t->ReadIntervalTimeout : wait;
+      if ((deadline >= 0) && (wait < 0))
+         wait = 0;
+      n = poll(&pfd, 1, wait);
+      if ((n < 0) && (errno == EINTR))
+         continue;
+      if (n <= 0)
+         break;                        // timeout expired
+      n = read(port->fd, (char*)buffer + *read_N, N - *read_N);
+      if (n <= 0)
+         return (n == 0);
+      *read_N = *read_N + n;
+   }
+   return TRUE;
+}
+
+static inline BOOL WriteFile(HANDLE h, const void* buffer, DWORD N, LPDWORD written_N, void* overlapped)
+{
+   posix_port* port = posix_lookup(h);
+   ssize_t     n;
+
+   (void)overlapped;
+   *written_N = 0;
+   if (!port)
+      return FALSE;
+   while (*written_N < N)
+   {
+      n = write(port->fd, (const char*)buffer + *written_N, N - *written_N);
+      if ((n < 0) && (errno == EINTR))
+         continue;
+      if (n <= 0)
+         return FALSE;
+      *written_N = *written_N + n;
+   }
+   return TRUE;
+}
+
+typedef union
+{
+   int64_t QuadPart;
+} LARGE_INTEGER;
+
+static inline BOOL QueryPerformanceCounter(LARGE_INTEGER* count)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   count->QuadPart = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+   return TRUE;
+}
+
+static inline BOOL QueryPerformanceFrequency(LARGE_INTEGER* freq)
+{
+   freq->QuadPart = 1000000000LL;      // counter runs in ns
+   return TRUE;
+}
+
+static inline void Sleep(DWORD ms)
+{
+   struct timespec ts;
+
+   ts.tv_sec  = ms / 1000;
+   ts.tv_nsec = (ms % 1000) * 1000000L;
+   nanosleep(&ts, NULL);
+}
+
+#endif